@@ -4,7 +4,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <buddy_pmm.h>
+#include <pmm.h>
 #include <vmm.h>
+#include <schedule.h>
+#include <slab.h>
+#include <shrinker.h>
+#include <error.h>
 
 struct Command {
     const char *name;
@@ -17,7 +22,16 @@ static struct Command commands[] = {
     {"help", "Display this list of commands.", monitor_help},
     {"kernel_info", "Display information about the kernel.", monitor_kernel_info},
     {"buddy_info", "Display information about the buddy system.", monitor_buddy_info},
+    {"buddy_stat", "Display alloc/free/fail counts and fragmentation index of each order.", monitor_buddy_stat},
     {"vma_info", "Display information about the vma of check_vma_struct.", monitor_vma_info},
+    {"schedule_info", "Display the run queue of each cpu.", monitor_schedule_info},
+    {"timer_bench", "Benchmark add/del of timers, default 10000 sleepers.", monitor_timer_bench},
+    {"slab_info", "Display usage of each slab cache.", monitor_slab_info},
+    {"slab_bench", "Benchmark kmalloc/kfree with and without magazines, default 100000.", monitor_slab_bench},
+    {"shrinker_info", "Display how many objects and pages each shrinker freed.", monitor_shrinker_info},
+    {"page_bench", "Benchmark alloc_page/free_page with and without per-cpu lists, default 100000.", monitor_page_bench},
+    {"tlb_bench", "Benchmark memcpy through 4M and 4K kernel mappings, default 64M.", monitor_tlb_bench},
+    {"fault_around", "Display page fault counts, or set the fault-around window in pages.", monitor_fault_around},
 	// {"backtrace", "Print backtrace of stack frame.", monitor_backtrace},
 };
 
@@ -45,22 +59,43 @@ static int parse(char *buf, char **argv) {
     return argc;
 }
 
+static struct Command *find_cmd(const char *name) {
+    int i;
+    for (i = 0; i < ARRAY_SIZE(commands); i ++) {
+        if (strcmp(commands[i].name, name) == 0) {
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
 static int run_cmd(char *buf, struct TrapFrame *tf) {
     char *argv[MAXARGS];
     int argc = parse(buf, argv);
     if (argc == 0) {
         return 0;
     }
-    int i;
-    for (i = 0; i < ARRAY_SIZE(commands); i ++) {
-        if (strcmp(commands[i].name, argv[0]) == 0) {
-            return commands[i].func(argc - 1, argv + 1, tf);
-        }
+    struct Command *cmd;
+    if ((cmd = find_cmd(argv[0])) != NULL) {
+        return cmd->func(argc - 1, argv + 1, tf);
     }
     printk("Unknown command '%s'\n", argv[0]);
     return 0;
 }
 
+// 在运行中的系统上执行一条命令(SYS_kmonitor)，用于查看统计信息和运行微基准测试。
+// 调用者持有大内核锁并且开着中断，与panic之后进入的monitor不同
+int monitor_run(char *buf, struct TrapFrame *tf) {
+    char *argv[MAXARGS];
+    int argc = parse(buf, argv);
+    struct Command *cmd;
+    if (argc == 0 || (cmd = find_cmd(argv[0])) == NULL) {
+        return -E_INVAL;
+    }
+    cmd->func(argc - 1, argv + 1, tf);
+    return 0;
+}
+
 void monitor(struct TrapFrame *tf) {
     printk("Welcome to the kernel debug monitor!!\n");
     printk("Type 'help' for a list of commands.\n");
@@ -89,6 +124,11 @@ int monitor_buddy_info(int argc, char **argv, struct TrapFrame *tf) {
     return 0;
 }
 
+int monitor_buddy_stat(int argc, char **argv, struct TrapFrame *tf) {
+    buddy_print_stats();
+    return 0;
+}
+
 int monitor_kernel_info(int argc, char **argv, struct TrapFrame *tf) {
     print_kerninfo();
     return 0;
@@ -106,4 +146,83 @@ int monitor_backtrace(int argc, char **argv, struct TrapFrame *tf) {
 int monitor_vma_info(int argc, char **argv, struct TrapFrame *tf) {
     print_vma();
     return 0;
-}
\ No newline at end of file
+}
+int monitor_schedule_info(int argc, char **argv, struct TrapFrame *tf) {
+    print_schedule();
+    return 0;
+}
+
+int monitor_timer_bench(int argc, char **argv, struct TrapFrame *tf) {
+    int n = 10000;
+    if (argc > 0) {
+        n = strtol(argv[0], NULL, 10);
+    }
+    if (n <= 0) {
+        printk("Usage: timer_bench [n]\n");
+        return 0;
+    }
+    timer_benchmark(n);
+    return 0;
+}
+
+int monitor_slab_info(int argc, char **argv, struct TrapFrame *tf) {
+    slab_print_info();
+    return 0;
+}
+
+int monitor_slab_bench(int argc, char **argv, struct TrapFrame *tf) {
+    int n = 100000;
+    if (argc > 0) {
+        n = strtol(argv[0], NULL, 10);
+    }
+    if (n <= 0) {
+        printk("Usage: slab_bench [n]\n");
+        return 0;
+    }
+    slab_benchmark(n);
+    return 0;
+}
+
+int monitor_shrinker_info(int argc, char **argv, struct TrapFrame *tf) {
+    shrinker_print_info();
+    return 0;
+}
+
+int monitor_page_bench(int argc, char **argv, struct TrapFrame *tf) {
+    int n = 100000;
+    if (argc > 0) {
+        n = strtol(argv[0], NULL, 10);
+    }
+    if (n <= 0) {
+        printk("Usage: page_bench [n]\n");
+        return 0;
+    }
+    page_benchmark(n);
+    return 0;
+}
+
+int monitor_tlb_bench(int argc, char **argv, struct TrapFrame *tf) {
+    int mb = 64;
+    if (argc > 0) {
+        mb = strtol(argv[0], NULL, 10);
+    }
+    if (mb <= 0) {
+        printk("Usage: tlb_bench [mb]\n");
+        return 0;
+    }
+    tlb_benchmark(mb);
+    return 0;
+}
+
+int monitor_fault_around(int argc, char **argv, struct TrapFrame *tf) {
+    if (argc > 0) {
+        int npages = strtol(argv[0], NULL, 10);
+        if (npages < 0) {
+            printk("Usage: fault_around [pages]\n");
+            return 0;
+        }
+        set_fault_around(npages);
+    }
+    fault_around_print_info();
+    return 0;
+}
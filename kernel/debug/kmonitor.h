@@ -12,12 +12,25 @@
 // optionally providing a trap frame indicating the current state
 // NULL if none
 void monitor(struct TrapFrame *tf);
+int monitor_run(char *buf, struct TrapFrame *tf);
+
+// SYS_kmonitor命令行的最大长度
+#define KMONITOR_CMD_LEN    64
 
 int monitor_help(int argc, char **argv, struct TrapFrame *tf);
 int monitor_kernel_info(int argc, char **argv, struct TrapFrame *tf);
 int monitor_backtrace(int argc, char **argv, struct TrapFrame *tf);
 int monitor_buddy_info(int argc, char **argv, struct TrapFrame *tf);
+int monitor_buddy_stat(int argc, char **argv, struct TrapFrame *tf);
 int monitor_vma_info(int argc, char **argv, struct TrapFrame *tf);
+int monitor_schedule_info(int argc, char **argv, struct TrapFrame *tf);
+int monitor_timer_bench(int argc, char **argv, struct TrapFrame *tf);
+int monitor_slab_info(int argc, char **argv, struct TrapFrame *tf);
+int monitor_slab_bench(int argc, char **argv, struct TrapFrame *tf);
+int monitor_shrinker_info(int argc, char **argv, struct TrapFrame *tf);
+int monitor_page_bench(int argc, char **argv, struct TrapFrame *tf);
+int monitor_tlb_bench(int argc, char **argv, struct TrapFrame *tf);
+int monitor_fault_around(int argc, char **argv, struct TrapFrame *tf);
 
 
 #endif // __KERNEL_MONITOR_H__
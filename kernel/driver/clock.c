@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <trap.h>
 #include <x86.h>
+#include <lapic.h>
+#include <time.h>
 
 #define IO_TIMER1       0x040
 
@@ -11,11 +13,24 @@
 
 #define TIMER_MODE      (IO_TIMER1 + 3)     // timer mode port
 #define TIMER_SEL0      0x00
+#define TIMER_SEL2      0x80
+#define TIMER_INTTC     0x00
 #define TIMER_RATEGEN   0x04
 #define TIMER_16BIT   0x30
 
+// 8253通道2的门控和输出在8255的B端口上
+#define IO_PORTB        0x061
+#define PORTB_GATE2     0x01
+#define PORTB_SPEAKER   0x02
+#define PORTB_OUT2      0x20
+
 volatile    size_t  ticks;
 
+// 启动时的tsc和tsc周期到纳秒的换算系数，见get_clock_ns
+uint64_t tsc_base;
+uint32_t tsc_mult;
+uint32_t tsc_khz;
+
 void set_ticks(size_t tick) {
     ticks = tick;
 }
@@ -24,15 +39,63 @@ size_t get_ticks(void) {
     return ticks;
 }
 
-void clock_init(void) {
-    // set 8253 timer-chip
-    // 设置定时时间为10ms
-    outb(TIMER_MODE, TIMER_SEL0 | TIMER_RATEGEN | TIMER_16BIT);
-    outb(IO_TIMER1, TIMER_DIV(1000) % 256);
-    outb(IO_TIMER1, TIMER_DIV(1000) / 256);
+// 使用8253的通道2忙等待usec微秒，不依赖中断，可用于校准其他定时器
+// 通道2工作在模式0，计数到0时OUT2变为高电平
+void pit_udelay(uint32_t usec) {
+    while (usec > 0) {
+        uint32_t chunk = (usec > 50000) ? 50000 : usec;
+        uint32_t count = chunk * (TIMER_FREQ / 100) / 10000;
+        uint8_t portb = inb(IO_PORTB) & ~(PORTB_SPEAKER | PORTB_GATE2);
 
+        outb(IO_PORTB, portb);
+        outb(TIMER_MODE, TIMER_SEL2 | TIMER_INTTC | TIMER_16BIT);
+        outb(IO_TIMER1 + 2, count % 256);
+        outb(IO_TIMER1 + 2, count / 256);
+        // 门控拉高后开始计数
+        outb(IO_PORTB, portb | PORTB_GATE2);
+        while (!(inb(IO_PORTB) & PORTB_OUT2)) {
+            /* do nothing */;
+        }
+        usec -= chunk;
+    }
+}
+
+// 用8253测量10ms内tsc增加的周期数，算出tsc的频率和换算系数
+// 假定各个cpu的tsc是同步的，并且频率不随cpu的电源状态变化
+static void tsc_calibrate(void) {
+    uint64_t start = read_tsc();
+    pit_udelay(10000);
+    uint32_t cycles = (uint32_t)(read_tsc() - start);
+    tsc_khz = cycles / 10;
+
+    uint64_t mult = (uint64_t)NSEC_PER_MSEC << TSC_SHIFT;
+    do_div(mult, tsc_khz);
+    tsc_mult = (uint32_t)mult;
+    tsc_base = read_tsc();
+    printk("tsc: %u khz.\n", tsc_khz);
+}
+
+// 从启动开始的单调纳秒时钟
+uint64_t get_clock_ns(void) {
+    return cycles_to_ns(read_tsc() - tsc_base, tsc_mult);
+}
+
+void clock_init(void) {
     // initialize time counter 'ticks' to zero
     ticks = 0;
+    tsc_calibrate();
+
+    if (lapic != NULL) {
+        // 多处理器下每个cpu都由lapic定时器产生时钟中断(见lapic_init)，不再使用8253
+        printk("++ setup lapic timer interrupts\n");
+        return;
+    }
+
+    // set 8253 timer-chip
+    // 设置时钟中断频率为TICK_HZ
+    outb(TIMER_MODE, TIMER_SEL0 | TIMER_RATEGEN | TIMER_16BIT);
+    outb(IO_TIMER1, TIMER_DIV(TICK_HZ) % 256);
+    outb(IO_TIMER1, TIMER_DIV(TICK_HZ) / 256);
 
     printk("++ setup timer interrupts\n");
     pic_enable(IRQ_TIMER);
@@ -3,9 +3,20 @@
 
 #include <types.h>
 
+// 每秒的时钟中断次数
+#define TICK_HZ     1000
+// 一个tick对应的纳秒数
+#define TICK_NS     (1000000000 / TICK_HZ)
+
+extern uint64_t tsc_base;
+extern uint32_t tsc_mult;
+extern uint32_t tsc_khz;
+
 void set_ticks(size_t tick);
 size_t get_ticks(void);
 void clock_init(void);
+void pit_udelay(uint32_t usec);
+uint64_t get_clock_ns(void);
 
 
 #endif //__KERNEL_DRIVER_CLOCK_H__
\ No newline at end of file
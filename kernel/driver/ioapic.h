@@ -0,0 +1,13 @@
+#ifndef __KERNEL_DRIVER_IOAPIC_H__
+#define __KERNEL_DRIVER_IOAPIC_H__
+
+#include <types.h>
+
+// io apic的mmio地址，在mp_init中从MP表中得到并映射
+extern volatile struct ioapic_struct *ioapic;
+extern uint8_t ioapic_id;
+
+void ioapic_init(void);
+void ioapic_enable(unsigned int irq, uint8_t apic_id);
+
+#endif // __KERNEL_DRIVER_IOAPIC_H__
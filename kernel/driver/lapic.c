@@ -0,0 +1,217 @@
+#include <types.h>
+#include <x86.h>
+#include <memlayout.h>
+#include <trap.h>
+#include <clock.h>
+#include <stdio.h>
+#include <lapic.h>
+
+// local apic寄存器，按uint32_t下标索引
+#define ID          (0x0020 / 4)    // ID
+#define VER         (0x0030 / 4)    // Version
+#define TPR         (0x0080 / 4)    // Task Priority
+#define EOI         (0x00B0 / 4)    // EOI
+#define SVR         (0x00F0 / 4)    // Spurious Interrupt Vector
+    #define ENABLE      0x00000100  // Unit Enable
+#define ESR         (0x0280 / 4)    // Error Status
+#define ICRLO       (0x0300 / 4)    // Interrupt Command
+    #define INIT        0x00000500  // INIT/RESET
+    #define STARTUP     0x00000600  // Startup IPI
+    #define DELIVS      0x00001000  // Delivery status
+    #define ASSERT      0x00004000  // Assert interrupt (vs deassert)
+    #define DEASSERT    0x00000000
+    #define LEVEL       0x00008000  // Level triggered
+    #define BCAST       0x00080000  // Send to all APICs, including self.
+    #define OTHERS      0x000C0000  // Send to all APICs, excluding self.
+    #define BUSY        0x00001000
+    #define FIXED       0x00000000
+#define ICRHI       (0x0310 / 4)    // Interrupt Command [63:32]
+#define TIMER       (0x0320 / 4)    // Local Vector Table 0 (TIMER)
+    #define X1          0x0000000B  // divide counts by 1
+    #define PERIODIC    0x00020000  // Periodic
+#define PCINT       (0x0340 / 4)    // Performance Counter LVT
+#define LINT0       (0x0350 / 4)    // Local Vector Table 1 (LINT0)
+#define LINT1       (0x0360 / 4)    // Local Vector Table 2 (LINT1)
+#define ERROR       (0x0370 / 4)    // Local Vector Table 3 (ERROR)
+    #define MASKED      0x00010000  // Interrupt masked
+#define TICR        (0x0380 / 4)    // Timer Initial Count
+#define TCCR        (0x0390 / 4)    // Timer Current Count
+#define TDCR        (0x03E0 / 4)    // Timer Divide Configuration
+
+// CMOS RTC的端口，用于设置warm reset vector
+#define IO_RTC      0x70
+
+volatile uint32_t *lapic = NULL;
+
+// lapic定时器每个tick需要的计数值，由bsp根据8253校准，ap直接复用
+static uint32_t lapic_timer_count = 0;
+
+static void lapic_write(int index, uint32_t value) {
+    lapic[index] = value;
+    // wait for write to finish, by reading
+    (void)lapic[ID];
+}
+
+// 用8253的通道2测量10ms内lapic定时器递减了多少，从而算出每个tick的计数值
+static uint32_t lapic_timer_calibrate(void) {
+    lapic_write(TDCR, X1);
+    lapic_write(TIMER, MASKED | (IRQ_OFFSET + IRQ_TIMER));
+    lapic_write(TICR, 0xFFFFFFFF);
+    pit_udelay(10000);
+    uint32_t elapsed = 0xFFFFFFFF - lapic[TCCR];
+    lapic_write(TICR, 0);
+    return elapsed / (10 * TICK_HZ / 1000);
+}
+
+void lapic_init(void) {
+    if (lapic == NULL) {
+        return;
+    }
+
+    // Enable local APIC; set spurious interrupt vector.
+    lapic_write(SVR, ENABLE | (IRQ_OFFSET + IRQ_SPURIOUS));
+
+    if (lapic_timer_count == 0) {
+        lapic_timer_count = lapic_timer_calibrate();
+        printk("lapic timer: %u counts per tick.\n", lapic_timer_count);
+    }
+
+    // 每个cpu使用自己的lapic定时器产生时钟中断，中断向量与8253的时钟中断相同
+    lapic_timer_periodic();
+
+    // Disable logical interrupt lines.
+    lapic_write(LINT0, MASKED);
+    lapic_write(LINT1, MASKED);
+
+    // Disable performance counter overflow interrupts
+    // on machines that provide that interrupt entry.
+    if (((lapic[VER] >> 16) & 0xFF) >= 4) {
+        lapic_write(PCINT, MASKED);
+    }
+
+    // Map error interrupt to IRQ_ERROR.
+    lapic_write(ERROR, IRQ_OFFSET + IRQ_ERROR);
+
+    // Clear error status register (requires back-to-back writes).
+    lapic_write(ESR, 0);
+    lapic_write(ESR, 0);
+
+    // Ack any outstanding interrupts.
+    lapic_write(EOI, 0);
+
+    // Send an Init Level De-Assert to synchronize arbitration ID's.
+    lapic_write(ICRHI, 0);
+    lapic_write(ICRLO, BCAST | INIT | LEVEL);
+    while (lapic[ICRLO] & DELIVS) {
+        /* do nothing */;
+    }
+
+    // Enable interrupts on the APIC (but not on the processor).
+    lapic_write(TPR, 0);
+}
+
+// 恢复每个tick一次的周期时钟中断
+void lapic_timer_periodic(void) {
+    lapic_write(TDCR, X1);
+    lapic_write(TIMER, PERIODIC | (IRQ_OFFSET + IRQ_TIMER));
+    lapic_write(TICR, lapic_timer_count);
+}
+
+// 一次性定时器，ticks个tick后产生一次时钟中断
+void lapic_timer_oneshot(uint32_t ticks) {
+    if (ticks > lapic_timer_max_ticks()) {
+        ticks = lapic_timer_max_ticks();
+    }
+    lapic_write(TDCR, X1);
+    lapic_write(TIMER, IRQ_OFFSET + IRQ_TIMER);
+    lapic_write(TICR, ticks * lapic_timer_count);
+}
+
+// 一次性定时器，count个lapic计数后产生一次时钟中断，用于不在tick边界上的高精度定时器
+void lapic_timer_oneshot_count(uint32_t count) {
+    lapic_write(TDCR, X1);
+    lapic_write(TIMER, IRQ_OFFSET + IRQ_TIMER);
+    lapic_write(TICR, count > 0 ? count : 1);
+}
+
+// 距离下一次定时器中断还剩多少个lapic计数
+uint32_t lapic_timer_remain(void) {
+    return lapic[TCCR];
+}
+
+// ns纳秒对应的lapic计数，超出一次性定时器的范围时返回最大值
+uint32_t lapic_timer_ns_to_count(uint64_t ns) {
+    uint64_t count = ns * lapic_timer_count;
+    do_div(count, TICK_NS);
+    return count > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)count;
+}
+
+void lapic_timer_stop(void) {
+    lapic_write(TIMER, MASKED | (IRQ_OFFSET + IRQ_TIMER));
+    lapic_write(TICR, 0);
+}
+
+// 一次性定时器从设置到现在经过的完整tick数
+uint32_t lapic_timer_elapsed(void) {
+    return (lapic[TICR] - lapic[TCCR]) / lapic_timer_count;
+}
+
+// 一次性定时器最多能定时的tick数
+uint32_t lapic_timer_max_ticks(void) {
+    return 0xFFFFFFFF / lapic_timer_count;
+}
+
+int lapic_id(void) {
+    if (lapic == NULL) {
+        return 0;
+    }
+    return lapic[ID] >> 24;
+}
+
+void lapic_eoi(void) {
+    if (lapic != NULL) {
+        lapic_write(EOI, 0);
+    }
+}
+
+// Start additional processor running entry code at addr.
+// See Appendix B of MultiProcessor Specification.
+void lapic_start_ap(uint8_t apic_id, uintptr_t addr) {
+    int i;
+    uint16_t *wrv;
+
+    // "The BSP must initialize CMOS shutdown code to 0AH
+    // and the warm reset vector (DWORD based at 40:67) to point at
+    // the AP startup code prior to the [universal startup algorithm]."
+    outb(IO_RTC, 0xF);  // offset 0xF is shutdown code
+    outb(IO_RTC + 1, 0x0A);
+    wrv = (uint16_t *)((0x40 << 4 | 0x67) + KERNEL_BASE);  // Warm reset vector
+    wrv[0] = 0;
+    wrv[1] = addr >> 4;
+
+    // "Universal startup algorithm."
+    // Send INIT (level-triggered) interrupt to reset other CPU.
+    lapic_write(ICRHI, apic_id << 24);
+    lapic_write(ICRLO, INIT | LEVEL | ASSERT);
+    pit_udelay(200);
+    lapic_write(ICRLO, INIT | LEVEL);
+    pit_udelay(10000);
+
+    // Send startup IPI (twice!) to enter code.
+    // Regular hardware is supposed to only accept a STARTUP
+    // when it is in the halted state due to an INIT.  So the second
+    // should be ignored, but it is part of the official Intel algorithm.
+    for (i = 0; i < 2; i++) {
+        lapic_write(ICRHI, apic_id << 24);
+        lapic_write(ICRLO, STARTUP | (addr >> 12));
+        pit_udelay(200);
+    }
+}
+
+void lapic_send_ipi(uint8_t apic_id, int vector) {
+    lapic_write(ICRHI, apic_id << 24);
+    lapic_write(ICRLO, FIXED | ASSERT | vector);
+    while (lapic[ICRLO] & DELIVS) {
+        /* do nothing */;
+    }
+}
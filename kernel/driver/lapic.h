@@ -0,0 +1,24 @@
+#ifndef __KERNEL_DRIVER_LAPIC_H__
+#define __KERNEL_DRIVER_LAPIC_H__
+
+#include <types.h>
+
+// local apic的mmio地址，在mp_init中从MP表中得到并映射
+// 没有找到MP表时为NULL，此时内核退化为单处理器，使用8259A和8253
+extern volatile uint32_t *lapic;
+
+void lapic_init(void);
+int lapic_id(void);
+void lapic_eoi(void);
+void lapic_timer_periodic(void);
+void lapic_timer_oneshot(uint32_t ticks);
+void lapic_timer_oneshot_count(uint32_t count);
+uint32_t lapic_timer_remain(void);
+uint32_t lapic_timer_ns_to_count(uint64_t ns);
+void lapic_timer_stop(void);
+uint32_t lapic_timer_elapsed(void);
+uint32_t lapic_timer_max_ticks(void);
+void lapic_start_ap(uint8_t apic_id, uintptr_t addr);
+void lapic_send_ipi(uint8_t apic_id, int vector);
+
+#endif // __KERNEL_DRIVER_LAPIC_H__
@@ -2,6 +2,7 @@
 #include <x86.h>
 
 #include <pic_irq.h>
+#include <ioapic.h>
 #include <trap.h>
 
 #define IO_PIC1		0X20	// master: irqs 0-7
@@ -14,6 +15,9 @@
 // slave irq 接在master irq的第二个中断上，因此需要将主中断的第二个中断屏蔽去除，并且第二个中断不会被其他外设使用
 static uint16_t irq_mask = 0xffff & ~(1 << IRQ_SLAVE);
 static bool did_init = 0;
+// 多处理器下外设中断改由ioapic路由，8259A被全部屏蔽
+static bool use_ioapic = 0;
+static uint8_t ioapic_dest;
 
 static void pic_set_mask(uint16_t mask)
 {
@@ -25,9 +29,29 @@ static void pic_set_mask(uint16_t mask)
 }
 
 void pic_enable(unsigned int irq) {
+	if (use_ioapic) {
+		ioapic_enable(irq, ioapic_dest);
+		return;
+	}
 	pic_set_mask(irq_mask & ~(1 << irq));
 }
 
+// 将8259A上已经使能的中断转交给ioapic，之后的pic_enable也都走ioapic，
+// 中断统一发送给apic_id对应的cpu
+void pic_route_to_ioapic(uint8_t apic_id) {
+	uint16_t mask = irq_mask;
+	unsigned int irq;
+
+	ioapic_dest = apic_id;
+	use_ioapic = 1;
+	pic_set_mask(0xFFFF);
+	for (irq = 0; irq < 16; irq++) {
+		if (irq != IRQ_SLAVE && !(mask & (1 << irq))) {
+			ioapic_enable(irq, apic_id);
+		}
+	}
+}
+
 void pic_init(void)
 {
 	did_init = 1;
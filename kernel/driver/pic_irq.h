@@ -1,7 +1,10 @@
 #ifndef __KERNEL_DRIVER_PIC_IRQ_H__
 #define __KERNEL_DRIVER_PIC_IRQ_H__
 
+#include <types.h>
+
 void pic_init(void);
 void pic_enable(unsigned int irq);
+void pic_route_to_ioapic(uint8_t apic_id);
 
 #endif // __KERNEL_DRIVER_PIC_IRQ_H__
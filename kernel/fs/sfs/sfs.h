@@ -8,6 +8,7 @@
 #include <dev.h>
 #include <stdlib.h>
 #include <bitmap.h>
+#include <shrinker.h>
 
 
 #define SFS_MAGIC           0x2f8dbe2a
@@ -108,6 +109,8 @@ typedef struct sfs_fs {
     // 该链表用于链接SfsInode节点
     ListEntry inode_list;
     ListEntry *hash_list;
+    // 回收inode_list中没有被引用的inode
+    Shrinker shrinker;
 } SfsFs;
 
 #define SFS_HLIST_SHIFT                 10
@@ -142,5 +145,6 @@ int sfs_sync_freemap(SfsFs *sfs);
 int sfs_clear_block(SfsFs *sfs, uint32_t blk_no, uint32_t num_blks);
 
 int sfs_load_inode(SfsFs *sfs, struct inode **node_store, uint32_t ino);
+size_t sfs_evict_inodes(SfsFs *sfs);
 
 #endif //__KERNEL_FS_SFS_H__
\ No newline at end of file
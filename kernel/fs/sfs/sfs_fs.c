@@ -46,12 +46,19 @@ static Inode *sfs_get_root(Fs *fs) {
     return node;
 }
 
+// 不再使用的干净inode随时可以从磁盘重新读入，总是全部释放
+static size_t sfs_shrink(Shrinker *shrinker, size_t nr_pages) {
+    return sfs_evict_inodes(container_of(shrinker, SfsFs, shrinker));
+}
+
 static int sfs_unmount(Fs *fs) {
     SfsFs *sfs = fsop_info(fs, sfs);
+    sfs_evict_inodes(sfs);
     if (!list_empty(&(sfs->inode_list))) {
         return -E_BUSY;
     }
     assert(!sfs->super_dirty);
+    unregister_shrinker(&(sfs->shrinker));
     bitmap_destory(sfs->freemap);
     kfree(sfs->sfs_buffer);
     kfree(sfs->hash_list);
@@ -186,6 +193,7 @@ static int sfs_do_mount(Device *dev, Fs **fs_store) {
     sem_init(&(sfs->mutex_sem), 1);
 
     list_init(&(sfs->inode_list));
+    register_shrinker(&(sfs->shrinker), "sfs_inode", sfs_shrink);
     printk("sfs: mount: '%s' (%d/%d/%d)\n", sfs->super.info,
            blocks - unused_blocks,
            unused_blocks,
@@ -748,10 +748,16 @@ static int sfs_reclaim(Inode *node) {
         for (nblks = sfs_inode->disk_inode->blocks; nblks != 0; nblks--) {
             sfs_block_truncate_nolock(sfs, sfs_inode);
         }
-    } else if (sfs_inode->dirty) {
-        if ((ret = vop_fsync(node)) != 0) {
-            goto failed_unlock;
+    } else {
+        if (sfs_inode->dirty) {
+            if ((ret = vop_fsync(node)) != 0) {
+                goto failed_unlock;
+            }
         }
+        // 文件还存在，暂时把inode留在inode_list和hash_list中，
+        // 下次打开时可以直接使用，内存紧张时由sfs的shrinker回收
+        unlock_sfs_fs(sfs);
+        return 0;
     }
     sfs_remove_links(sfs_inode);
     unlock_sfs_fs(sfs);
@@ -778,6 +784,30 @@ failed_unlock:
     return ret;
 }
 
+// 释放所有没有被引用的inode，返回释放的inode个数
+size_t sfs_evict_inodes(SfsFs *sfs) {
+    size_t nr_evicted = 0;
+    lock_sfs_fs(sfs);
+    {
+        ListEntry *head = &(sfs->inode_list), *entry = list_next(head);
+        while (entry != head) {
+            SfsInode *sfs_inode = le2sfsinode(entry, inode_link);
+            Inode *node = info2node(sfs_inode, sfs_inode);
+            entry = list_next(entry);
+            if (inode_ref_count(node) != 0 || sfs_inode->dirty) {
+                continue;
+            }
+            assert(sfs_inode->reclaim_count == 0 && inode_open_count(node) == 0);
+            sfs_remove_links(sfs_inode);
+            kfree(sfs_inode->disk_inode);
+            vop_kill(node);
+            nr_evicted++;
+        }
+    }
+    unlock_sfs_fs(sfs);
+    return nr_evicted;
+}
+
 static int sfs_get_type(Inode *node, uint32_t *type_store) {
     SfsDiskInode *disk_inode = vop_info(node, sfs_inode)->disk_inode;
     switch (disk_inode->type)
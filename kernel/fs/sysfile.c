@@ -11,7 +11,8 @@
 
 #define IOBUF_SIZE          4096
 
-static int copy_path(char **to, const char *from) {
+// 把用户态的路径拷贝到内核中，调用者负责kfree
+int copy_path(char **to, const char *from) {
     MmStruct *mm = current->mm;
     char *buffer = NULL;
     if ((buffer = kmalloc(FS_MAX_FPATH_LEN + 1)) == NULL) {
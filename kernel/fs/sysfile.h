@@ -6,6 +6,7 @@
 struct stat;
 struct dirent;
 
+int copy_path(char **to, const char *from);
 int sysfile_open(const char *open, uint32_t open_flags);
 int sysfile_close(int df);
 int sysfile_read(int df, void *base, size_t len);
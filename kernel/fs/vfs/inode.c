@@ -7,9 +7,17 @@
 #include <atomic.h>
 #include <string.h>
 
+static kmem_cache_t *inode_cachep = NULL;
+
+void inode_cache_init(void) {
+    if ((inode_cachep = kmem_cache_create("inode", sizeof(Inode), 0, NULL)) == NULL) {
+        panic("inode_cache_init: create slab cache failed.\n");
+    }
+}
+
 Inode *__alloc_inode(int type) {
     Inode *node = NULL;
-    if ((node = kmalloc(sizeof(Inode))) != NULL) {
+    if ((node = kmem_cache_alloc(inode_cachep)) != NULL) {
         node->in_type = type;
     }
     return node;
@@ -26,7 +34,7 @@ void inode_init(Inode *node, const InodeOperations *ops, struct fs *fs) {
 void inode_kill(Inode *node) {
     assert(inode_ref_count(node) == 0);
     assert(inode_open_count(node) == 0);
-    kfree(node);
+    kmem_cache_free(inode_cachep, node);
 }
 
 int inode_ref_inc(Inode *node) {
@@ -43,6 +43,7 @@ typedef struct inode {
 #define info2node(info, type)           \
     container_of((info), Inode, in_info.__##type##_info)
 
+void inode_cache_init(void);
 Inode *__alloc_inode(int type);
 
 #define alloc_inode(type)       __alloc_inode(__in_type(type))
@@ -18,6 +18,7 @@ Fs *__alloc_fs(int type) {
 }
 
 void vfs_init(void) {
+    inode_cache_init();
     sem_init(&bootfs_sem, 1);
     vfs_dev_list_init();
 }
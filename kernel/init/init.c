@@ -15,6 +15,9 @@
 #include <process.h>
 #include <schedule.h>
 #include <fs.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <fpu.h>
 
 void printk_test(void)
 {
@@ -44,6 +47,10 @@ void start_kernel(void)
 	// bss段清零
 	memset(edata, 0, end - edata);
 
+	// bsp在内核初始化期间一直持有大内核锁，直到进入cpu_idle
+	spinlock_init(&kernel_lock);
+	lock_kernel();
+
 	// 终端初始化，显示和键盘输入初始化
 	// 在这个函数中调用了pic_enable将serial中断使能
 	// 本应该是不生效的，只是pic_enable用一个局部变量记录下了这个中断掩码，
@@ -77,9 +84,14 @@ void start_kernel(void)
 	// 测试发现，我们使用物理地址时反而跑飞，使用虚拟地址可以正常工作，说明开启分页后，lgdt指令使用的是虚拟地址
 	pmm_init();
 
+	// 解析MP表，映射lapic和ioapic，多处理器时外设中断改由ioapic路由
+	mp_init();
+
 	// 初始化中断描述符表，此处已经开启了分页，加载的中断描述符地址应该是虚拟地址，
 	// 不是物理地址，所以应该找不到中断描述符地址才对？此处为什么没有错误？
 	idt_init();
+	// 开启fpu/sse，进程第一次使用时再恢复其状态
+	fpu_init();
 
 	vmm_init();
 	schedule_init();
@@ -93,6 +105,9 @@ void start_kernel(void)
 	clock_init();
 	// 开启总中断
 	intr_enable();
+
+	// 启动其他cpu，必须在创建第一个用户进程之前
+	mp_boot_ap();
 	
 	// while(1)
 	// 	monitor(NULL);
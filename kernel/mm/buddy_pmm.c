@@ -3,6 +3,7 @@
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
+#include <sync.h>
 
 #define MAX_ORDER   10
 static free_area_t free_area[MAX_ORDER + 1];
@@ -13,14 +14,68 @@ static free_area_t free_area[MAX_ORDER + 1];
 #define MAX_ZONE_NUM    10
 struct Zone {
     struct Page *mem_base;
+    size_t npages;
+    size_t map_base[MAX_ORDER];     // 每个order的free_map中该zone第一对伙伴的比特下标
 } zones[MAX_ZONE_NUM] = {{NULL}};
 
+// free_map: 每个order中的每一对伙伴对应一个比特，值为两个伙伴是否空闲的异或，
+// 释放时翻转该比特，翻转前为1说明伙伴是空闲的，可以合并，不需要再去检查伙伴page的标志
+#define MAX_PAGES       (KERNEL_MEM_SIZE / PAGE_SIZE)
+#define FREE_MAP_WORDS  (MAX_PAGES / 32 + MAX_ORDER * 2)
+static uint32_t free_map_storage[FREE_MAP_WORDS];
+static uint32_t *free_map[MAX_ORDER];
+static size_t free_map_bits[MAX_ORDER];     // 每个order中已经被zone占用的比特数
+
+// 每个order的申请、释放、失败以及合并次数
+static struct {
+    size_t nr_alloc;
+    size_t nr_release;
+    size_t nr_fail;
+    size_t nr_merge;
+} buddy_stats[MAX_ORDER + 1];
+
+#define free_map_max_bits(order)    ((MAX_PAGES >> ((order) + 1)) + MAX_ZONE_NUM)
+
 static void buddy_init(void) {
     int i;
+    uint32_t *map = free_map_storage;
     for (i = 0; i <= MAX_ORDER; i++) {
         list_init(&free_list(i));
         nr_free(i) = 0;
     }
+    for (i = 0; i < MAX_ORDER; i++) {
+        free_map[i] = map;
+        free_map_bits[i] = 0;
+        map += ROUNDUP_DIV(free_map_max_bits(i), 32);
+    }
+    assert(map <= free_map_storage + FREE_MAP_WORDS);
+}
+
+// 伙伴idx和idx ^ (1 << order)在free_map中对应的比特下标
+static inline size_t free_map_index(int zone_num, ppn_t idx, size_t order) {
+    return zones[zone_num].map_base[order] + (idx >> (order + 1));
+}
+
+// 翻转idx所在伙伴对的比特，返回翻转前的值
+static inline bool free_map_toggle(int zone_num, ppn_t idx, size_t order) {
+    if (order >= MAX_ORDER) {
+        return false;
+    }
+    size_t nr = free_map_index(zone_num, idx, order);
+    return test_and_change_bit(nr % 32, free_map[order] + nr / 32);
+}
+
+static inline bool free_map_test(int zone_num, ppn_t idx, size_t order) {
+    size_t nr = free_map_index(zone_num, idx, order);
+    return test_bit(nr % 32, free_map[order] + nr / 32);
+}
+
+static inline ppn_t page2idx(struct Page *page) {
+    return page - zones[page->zone_num].mem_base;
+}
+
+static inline struct Page *idx2page(int zone_num, ppn_t idx) {
+    return zones[zone_num].mem_base + idx;
 }
 
 static void buddy_init_memmap(struct Page *base, size_t n) {
@@ -33,14 +88,24 @@ static void buddy_init_memmap(struct Page *base, size_t n) {
         p->zone_num = zone_num;
         set_page_ref(p, 0);
     }
-    p = zones[zone_num++].mem_base = base;
-    size_t order = MAX_ORDER;
+    struct Zone *zone = zones + zone_num;
+    zone->npages = n;
+    size_t order;
+    for (order = 0; order < MAX_ORDER; order++) {
+        zone->map_base[order] = free_map_bits[order];
+        free_map_bits[order] += (n >> (order + 1)) + 1;
+        assert(free_map_bits[order] <= free_map_max_bits(order));
+    }
+    p = zone->mem_base = base;
+    zone_num++;
+    order = MAX_ORDER;
     size_t order_size = (1 << order);
     while (n != 0) {
         while (n >= order_size) {
             p->property = order;
             SetPageProperty(p);
             list_add(&free_list(order), &(p->page_link));
+            free_map_toggle(p->zone_num, page2idx(p), order);
             n -= order_size;
             p += order_size;
             nr_free(order)++;
@@ -70,6 +135,7 @@ static inline struct Page *buddy_alloc_pages_sub(size_t order) {
             list_del(le);
             size_t size = 1 << cur_order;
             nr_free(cur_order)--;
+            free_map_toggle(page->zone_num, page2idx(page), cur_order);
             while (cur_order > order) {
                 cur_order--;
                 size >>= 1;
@@ -78,11 +144,14 @@ static inline struct Page *buddy_alloc_pages_sub(size_t order) {
                 SetPageProperty(buddy);
                 nr_free(cur_order)++;
                 list_add(&free_list(cur_order), &(buddy->page_link));
+                free_map_toggle(buddy->zone_num, page2idx(buddy), cur_order);
             }
             ClearPageProperty(page);
+            buddy_stats[order].nr_alloc++;
             return page;
         }
     }
+    buddy_stats[order].nr_fail++;
     return NULL;
 }
 
@@ -107,14 +176,6 @@ static inline bool page_is_buddy(struct Page *page, size_t order, int zone_num)
     return 0;
 }
 
-static inline ppn_t page2idx(struct Page *page) {
-    return page - zones[page->zone_num].mem_base;
-}
-
-static inline struct Page *idx2page(int zone_num, ppn_t idx) {
-    return zones[zone_num].mem_base + idx;
-}
-
 static void buddy_free_pages_sub(struct Page *base, size_t order) {
     ppn_t buddy_idx;
     ppn_t page_idx = page2idx(base);
@@ -126,15 +187,15 @@ static void buddy_free_pages_sub(struct Page *base, size_t order) {
         set_page_ref(p, 0);
     }
     int zone_num = base->zone_num;
-    while (order < MAX_ORDER) {
+    buddy_stats[order].nr_release++;
+    // 比特翻转前为0说明伙伴没有空闲(或者伙伴超出了zone的范围)，不能再合并
+    while (free_map_toggle(zone_num, page_idx, order)) {
         buddy_idx = page_idx ^ (1 << order);
         struct Page *buddy = idx2page(zone_num, buddy_idx);
-        if (!page_is_buddy(buddy, order, zone_num)) {
-            break;
-        }
         nr_free(order)--;
         list_del(&(buddy->page_link));
         ClearPageProperty(buddy);
+        buddy_stats[order].nr_merge++;
         page_idx &= buddy_idx;
         order++;
     }
@@ -184,6 +245,24 @@ static size_t buddy_nr_free_pages(void) {
     return ret;
 }
 
+// 检查free_map中的每个比特都等于对应的两个伙伴是否空闲的异或
+static void check_free_map(void) {
+    int zone_num;
+    size_t order;
+    for (zone_num = 0; zone_num < MAX_ZONE_NUM && zones[zone_num].mem_base != NULL; zone_num++) {
+        size_t n = zones[zone_num].npages;
+        for (order = 0; order < MAX_ORDER; order++) {
+            ppn_t idx;
+            for (idx = 0; idx < n; idx += (2 << order)) {
+                ppn_t buddy_idx = idx + (1 << order);
+                bool free = page_is_buddy(idx2page(zone_num, idx), order, zone_num);
+                bool buddy_free = buddy_idx < n && page_is_buddy(idx2page(zone_num, buddy_idx), order, zone_num);
+                assert(free_map_test(zone_num, idx, order) == (free ^ buddy_free));
+            }
+        }
+    }
+}
+
 //buddy_check - check the correctness of buddy system
 static void buddy_check(void) {
     int i;
@@ -268,6 +347,7 @@ static void buddy_check(void) {
     }
     assert(count == 0);
     assert(total == 0);
+    check_free_map();
     // print_buddy();
 }
 
@@ -287,6 +367,63 @@ void print_buddy(void) {
     }
 }
 
+// 碎片指数(千分比)：申请order阶的连续page失败时，失败的原因是碎片(接近1000)还是内存不足(接近0)，
+// 有足够大的空闲块时返回-1
+static int __buddy_fragmentation_index(size_t order) {
+    size_t i, nr_blocks = 0;
+    for (i = 0; i <= MAX_ORDER; i++) {
+        if (i >= order && nr_free(i) != 0) {
+            return -1;
+        }
+        nr_blocks += nr_free(i);
+    }
+    if (nr_blocks == 0) {
+        return 0;
+    }
+    return 1000 - (1000 + buddy_nr_free_pages() * 1000 / (1 << order)) / nr_blocks;
+}
+
+int buddy_fragmentation_index(size_t order) {
+    int index;
+    bool flag;
+    local_intr_save(flag);
+    index = __buddy_fragmentation_index(order);
+    local_intr_restore(flag);
+    return index;
+}
+
+// page是否是一个order阶伙伴块的起始page，即在zone内按order对齐并且整个块都在zone内
+bool buddy_block_aligned(struct Page *page, size_t order) {
+    if (PageReserved(page) || order > MAX_ORDER) {
+        return false;
+    }
+    ppn_t idx = page2idx(page);
+    return (idx & ((1 << order) - 1)) == 0 && idx + (1 << order) <= zones[page->zone_num].npages;
+}
+
+void buddy_print_stats(void) {
+    size_t order;
+    bool flag;
+    local_intr_save(flag);
+    {
+        printk("buddy: %u free pages\n", buddy_nr_free_pages());
+        printk("%5s %8s %10s %10s %8s %10s %6s\n",
+            "order", "blocks", "allocs", "frees", "fails", "merges", "frag");
+        for (order = 0; order <= MAX_ORDER; order++) {
+            int index = __buddy_fragmentation_index(order);
+            printk("%5d %8d %10u %10u %8u %10u ", order, nr_free(order),
+                buddy_stats[order].nr_alloc, buddy_stats[order].nr_release,
+                buddy_stats[order].nr_fail, buddy_stats[order].nr_merge);
+            if (index < 0) {
+                printk("%6s\n", "-");
+            } else {
+                printk("%2d.%03d\n", index / 1000, index % 1000);
+            }
+        }
+    }
+    local_intr_restore(flag);
+}
+
 //the buddy system pmm
 const struct PmmManager buddy_pmm_manager = {
     .name = "buddy_pmm_manager",
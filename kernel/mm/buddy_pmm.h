@@ -5,5 +5,8 @@
 
 const struct PmmManager *get_buddy_pmm_manager(void);
 void print_buddy(void);
+void buddy_print_stats(void);
+int buddy_fragmentation_index(size_t order);
+bool buddy_block_aligned(struct Page *page, size_t order);
 
 #endif //__KERNEL_MM_BUDDY_PMM_H__
\ No newline at end of file
@@ -12,6 +12,8 @@
 // 用户栈空间大小为1M
 #define USER_STACK_PAGE 256
 #define USER_STACK_SIZE (USER_STACK_PAGE * PAGE_SIZE)
+// vdso页在用户栈的下方，与lib/vdso_data.h中的VDSO_BASE一致
+#define USER_VDSO       (USER_STACK_TOP - USER_STACK_SIZE - PAGE_SIZE)
 
 #define USER_BASE       0x00200000
 // 用户程序的加载地址
@@ -33,6 +35,9 @@
 #define K_STACK_PAGE    2
 #define K_STACK_SIZE (K_STACK_PAGE * PAGE_SIZE)
 
+// ap启动代码(mpentry.S)被拷贝到的物理地址，必须4K对齐且在1M以下
+#define MPENTRY_PADDR   0x7000
+
 // 内核代码段
 #define SEG_KTEXT	1
 // 内核数据段
@@ -44,6 +49,7 @@
 #define SEG_UDATA	4
 
 
+// 每个cpu都有一个tss段，cpu i的tss段为SEG_TSS + i
 #define SEG_TSS		5
 
 #define GD_KTEXT 	((SEG_KTEXT) << 3)	// kernel text
@@ -96,6 +102,7 @@ struct Page {
 #define PG_dirty                    3       // page被修改了
 #define PG_swap                     4       // 
 #define PG_active                   5       // page 被放在了active链表上
+#define PG_movable                  6       // 内存规整时标记被用户页表映射、可以迁移的page
 
 #define SetPageReserved(page)       set_bit(PG_reserved, &((page)->flags))
 #define ClearPageReserved(page)     clear_bit(PG_reserved, &((page)->flags))
@@ -115,6 +122,9 @@ struct Page {
 #define SetPageActive(page)         set_bit(PG_active, &((page)->flags))
 #define ClearPageActive(page)       clear_bit(PG_active, &((page)->flags))
 #define PageActive(page)            test_bit(PG_active, &((page)->flags))
+#define SetPageMovable(page)        set_bit(PG_movable, &((page)->flags))
+#define ClearPageMovable(page)      clear_bit(PG_movable, &((page)->flags))
+#define PageMovable(page)           test_bit(PG_movable, &((page)->flags))
 
 
 #define le2page(le, member)         \
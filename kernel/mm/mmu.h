@@ -249,4 +249,9 @@ struct TaskState {
 #define CR0_CD		0x40000000	// Cache Disable
 #define CR0_PG		0x80000000	// Paging
 
+#define CR4_PSE		0x00000010	// Page Size Extensions
+#define CR4_PGE		0x00000080	// Page Global Enable
+#define CR4_OSFXSR	0x00000200	// OS supports FXSAVE/FXRSTOR
+#define CR4_OSXMMEXCPT	0x00000400	// OS supports unmasked SIMD exceptions
+
 #endif
@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <swap.h>
 #include <slab.h>
+#include <cpu.h>
 
 
 static struct SegDesc gdt[] = {
@@ -20,15 +21,13 @@ static struct SegDesc gdt[] = {
     [SEG_KDATA] = SEG(STA_W, 0x0, 0xFFFFFFFF, DPL_KERNEL),
     [SEG_UTEXT] = SEG(STA_X | STA_R, 0x0, 0xFFFFFFFF, DPL_USER),
     [SEG_UDATA] = SEG(STA_W, 0x0, 0xFFFFFFFF, DPL_USER),
-    [SEG_TSS]   = SEG_NULL,
+    [SEG_TSS ... SEG_TSS + NCPU - 1] = SEG_NULL,
 };
 
 static struct PseudoDescriptor gdt_pd = {
     sizeof(gdt) - 1, (uintptr_t)gdt
 };
 
-static struct TaskState ts = {0};
-
 struct Page *pages_base;
 
 size_t pages_num = 0;
@@ -72,20 +71,33 @@ static inline void pmm_lgdt(struct PseudoDescriptor *pd) {
 // uint8_t stack0[1024];
 
 void load_esp0(uintptr_t esp0) {
-    ts.ts_esp0 = esp0;
+    this_cpu()->ts.ts_esp0 = esp0;
 }
 
-static void gdt_init(void) {
-    load_esp0(boot_stack_top);
+// 加载页目录，与cpu当前加载的页目录相同时不重新加载cr3，避免刷新tlb
+void load_page_dir(pde_t *page_dir) {
+    Cpu *cpu = this_cpu();
+    if (cpu->page_dir != (uintptr_t)page_dir) {
+        cpu->page_dir = (uintptr_t)page_dir;
+        lcr3(PADDR(page_dir));
+    }
+}
+
+// 每个cpu都要调用一次，各自使用gdt中自己的tss段
+void gdt_init(void) {
+    Cpu *cpu = this_cpu();
+    struct TaskState *ts = &(cpu->ts);
+
+    load_esp0((uintptr_t)boot_stack_top);
 
-    ts.ts_ss0 = KERNEL_DS;
+    ts->ts_ss0 = KERNEL_DS;
 
-    gdt[SEG_TSS] = SEGTSS(STS_T32A, (uint32_t)&ts, sizeof(ts), DPL_KERNEL);
+    gdt[SEG_TSS + cpu->id] = SEGTSS(STS_T32A, (uint32_t)ts, sizeof(*ts), DPL_KERNEL);
 
     pmm_lgdt(&gdt_pd);
 
     // load tss
-    ltr(GD_TSS);
+    ltr(GD_TSS + (cpu->id << 3));
 }
 
 static void init_pmm_manager(void) {
@@ -105,35 +117,247 @@ static void check_alloc_page(void) {
     printk("check_alloc_page() successed!\n");
 }
 
-struct Page *alloc_pages(size_t n) {
+// 每个cpu缓存的单个page，分为hot和cold两个链表：
+// hot链表中的page刚被释放，很可能还在cpu cache中，申请时优先使用；
+// cold链表中的page内容不会再被cpu访问(比如刚换出到磁盘)，适合给马上要被覆盖的page使用。
+// 每次从伙伴系统批量申请和归还PCP_BATCH个page，摊薄关中断以及拆分合并伙伴的开销
+#define PCP_HIGH        64      // 每个链表最多缓存的page数，超过时归还PCP_BATCH个
+#define PCP_BATCH       16
+
+typedef struct {
+    ListEntry list;
+    size_t count;
+} pcp_list_t;
+
+typedef struct {
+    pcp_list_t hot;
+    pcp_list_t cold;
+} per_cpu_pages_t;
+
+static per_cpu_pages_t per_cpu_pages[NCPU];
+static size_t nr_pcp_pages = 0;
+// 伙伴系统的检查会清空空闲链表，因此检查完成之后才启用
+static bool pcp_enabled = false;
+
+static void pcp_init(void) {
+    int i;
+    for (i = 0; i < NCPU; i++) {
+        list_init(&(per_cpu_pages[i].hot.list));
+        list_init(&(per_cpu_pages[i].cold.list));
+        per_cpu_pages[i].hot.count = per_cpu_pages[i].cold.count = 0;
+    }
+}
+
+static inline void pcp_add(pcp_list_t *pcp, struct Page *page, bool tail) {
+    if (tail) {
+        list_add_before(&(pcp->list), &(page->page_link));
+    } else {
+        list_add(&(pcp->list), &(page->page_link));
+    }
+    pcp->count++;
+    nr_pcp_pages++;
+}
+
+static inline struct Page *pcp_del(pcp_list_t *pcp, bool tail) {
+    ListEntry *entry = tail ? list_prev(&(pcp->list)) : list_next(&(pcp->list));
+    list_del(entry);
+    pcp->count--;
+    nr_pcp_pages--;
+    return le2page(entry, page_link);
+}
+
+// 把pcp链表尾部(最久没有使用)的n个page还给伙伴系统，调用时已经关中断
+static void pcp_free_batch(pcp_list_t *pcp, size_t n) {
+    while (n-- > 0 && pcp->count > 0) {
+        pmm_manager->free_pages(pcp_del(pcp, true), 1);
+    }
+}
+
+// 从伙伴系统批量申请page填充pcp链表，优先一次申请连续的PCP_BATCH个page
+static void pcp_refill(pcp_list_t *pcp) {
+    struct Page *page;
+    size_t i;
+    if ((page = pmm_manager->alloc_pages(PCP_BATCH)) != NULL) {
+        for (i = 0; i < PCP_BATCH; i++) {
+            pcp_add(pcp, page + i, true);
+        }
+        return;
+    }
+    for (i = 0; i < PCP_BATCH; i++) {
+        if ((page = pmm_manager->alloc_pages(1)) == NULL) {
+            break;
+        }
+        pcp_add(pcp, page, true);
+    }
+}
+
+static struct Page *pcp_alloc_page(bool cold) {
+    per_cpu_pages_t *pcps = per_cpu_pages + this_cpu()->id;
+    pcp_list_t *pcp = cold ? &(pcps->cold) : &(pcps->hot);
+    if (pcp->count == 0) {
+        // 当前链表没有page时先借用另一个链表中的page，都没有时再找伙伴系统
+        pcp_list_t *other = cold ? &(pcps->hot) : &(pcps->cold);
+        if (other->count != 0) {
+            return pcp_del(other, cold);
+        }
+        pcp_refill(pcp);
+        if (pcp->count == 0) {
+            return NULL;
+        }
+    }
+    // hot page从链表头部取，cold page从链表尾部取
+    return pcp_del(pcp, cold);
+}
+
+static void pcp_free_page(struct Page *page, bool cold) {
+    per_cpu_pages_t *pcps = per_cpu_pages + this_cpu()->id;
+    pcp_list_t *pcp = cold ? &(pcps->cold) : &(pcps->hot);
+    pcp_add(pcp, page, cold);
+    if (pcp->count > PCP_HIGH) {
+        pcp_free_batch(pcp, PCP_BATCH);
+    }
+}
+
+// 把所有cpu缓存的page都还给伙伴系统，返回归还的page数
+size_t pcp_drain(void) {
+    size_t nr_pages;
+    int i;
+    bool flag;
+    local_intr_save(flag);
+    {
+        nr_pages = nr_pcp_pages;
+        for (i = 0; i < NCPU; i++) {
+            pcp_free_batch(&(per_cpu_pages[i].hot), per_cpu_pages[i].hot.count);
+            pcp_free_batch(&(per_cpu_pages[i].cold), per_cpu_pages[i].cold.count);
+        }
+        assert(nr_pcp_pages == 0);
+    }
+    local_intr_restore(flag);
+    return nr_pages;
+}
+
+// 能容纳n个page的最小伙伴块的阶
+static inline size_t pages_order(size_t n) {
+    size_t order = 0;
+    while ((1 << order) < n) {
+        order++;
+    }
+    return order;
+}
+
+static struct Page *__alloc_pages(size_t n, bool cold) {
     struct Page *page;
     bool flag;
 try_again:
     local_intr_save(flag);
-    page = pmm_manager->alloc_pages(n);
+    if (n == 1 && pcp_enabled) {
+        page = pcp_alloc_page(cold);
+    } else {
+        page = pmm_manager->alloc_pages(n);
+    }
     local_intr_restore(flag);
-    if (page == NULL && try_free_pages(n)) {
-        goto try_again;
+    if (page == NULL) {
+        // 缓存在各个cpu上的page可能正好能拼成需要的连续page
+        if (nr_pcp_pages != 0) {
+            pcp_drain();
+            goto try_again;
+        }
+        // 空闲page足够但没有足够大的连续块时，先尝试规整内存
+        if (n > 1 && compact_memory(pages_order(n))) {
+            goto try_again;
+        }
+        if (try_free_pages(n)) {
+            goto try_again;
+        }
     }
     return page;
 }
 
+static void __free_pages(struct Page *base, size_t n, bool cold) {
+    bool flag;
+    local_intr_save(flag);
+    if (n == 1 && pcp_enabled) {
+        pcp_free_page(base, cold);
+    } else {
+        pmm_manager->free_pages(base, n);
+    }
+    local_intr_restore(flag);
+}
+
+struct Page *alloc_pages(size_t n) {
+    return __alloc_pages(n, false);
+}
+
 void free_pages(struct Page *base, size_t n) {
+    __free_pages(base, n, false);
+}
+
+// 只从伙伴系统中取，失败时不规整内存也不换出page，
+// 用于透明大页这种分配不到也可以退回4K页的场合
+struct Page *try_alloc_pages(size_t n) {
+    struct Page *page;
     bool flag;
     local_intr_save(flag);
-    pmm_manager->free_pages(base, n);
+    page = pmm_manager->alloc_pages(n);
     local_intr_restore(flag);
+    return page;
+}
+
+struct Page *alloc_cold_page(void) {
+    return __alloc_pages(1, true);
+}
+
+void free_cold_page(struct Page *page) {
+    __free_pages(page, 1, true);
 }
 
+// 缓存在pcp链表中的page也算作空闲page
 size_t nr_free_pages(void) {
     size_t size;
     bool flag;
     local_intr_save(flag);
-    size = pmm_manager->nr_free_pages();
+    size = pmm_manager->nr_free_pages() + nr_pcp_pages;
     local_intr_restore(flag);
     return size;
 }
 
+// 单个page的alloc_page/free_page的开销：分别在使用和不使用pcp时，
+// 反复申请并释放n次(单个以及每批32个)page，统计平均每次的周期数
+#define PAGE_BENCH_BATCH    32
+
+static uint32_t page_bench_round(int n) {
+    struct Page *pages[PAGE_BENCH_BATCH];
+    int i, j;
+    uint64_t start = read_tsc();
+    for (i = 0; i < n; i++) {
+        free_page(alloc_page());
+    }
+    for (i = 0; i < n; i += PAGE_BENCH_BATCH) {
+        for (j = 0; j < PAGE_BENCH_BATCH; j++) {
+            pages[j] = alloc_page();
+        }
+        for (j = 0; j < PAGE_BENCH_BATCH; j++) {
+            free_page(pages[j]);
+        }
+    }
+    uint64_t cycles = read_tsc() - start;
+    do_div(cycles, 2 * ROUNDUP(n, PAGE_BENCH_BATCH));
+    return (uint32_t)cycles;
+}
+
+void page_benchmark(int n) {
+    bool enabled = pcp_enabled;
+    pcp_drain();
+    pcp_enabled = false;
+    uint32_t buddy_cycles = page_bench_round(n);
+    pcp_enabled = true;
+    uint32_t pcp_cycles = page_bench_round(n);
+    pcp_drain();
+    pcp_enabled = enabled;
+    printk("page_bench: %d alloc_page/free_page pairs, buddy %u cycles, per-cpu lists %u cycles.\n",
+        n, buddy_cycles, pcp_cycles);
+}
+
 static void page_init(void) {
     struct E820Map *memmap = (struct E820Map *)(0x8000 + KERNEL_BASE);
     uint64_t max_phy_addr = 0;
@@ -216,32 +440,18 @@ static void page_init(void) {
 //     return page2kva(page);
 // }
 
-extern pte_t entry_page_table[];
 extern pde_t entry_page_dir[];
 
 void kernel_page_table_init() {
     int i;
-    int page_cnt = 0;
 
     boot_pgdir = entry_page_dir;
     boot_cr3 = PADDR(boot_pgdir);
 
-    // 初始化所有的页表项，总共256个页表，每个页表1024项，总共可以映射1G的地址空间
-    // 实际上我们不需要映射1G的地址空间，应为内核最大可用的线性地址为896M，也就是224个页表
-    // page放在一个连续的1M地址空间中
-    pte_t *page_table = entry_page_table;
-    // int page_table_entries = 1024 * 256;
-    // 映射0xc0000000 ~ 0xf8000000的地址空间，需要224个页表
-    // 同时，我们实际的物理地址可能没有896M，此时肯能需要映射的页表就更小了
-    page_cnt = 224;
-    int page_table_entries = 1024 * page_cnt;
-    for (i = 1024; i < page_table_entries; i++) {
-        page_table[i] = (i << PAGE_SHIFT) | PTE_P | PTE_W; 
-    }
-    // 初始化224个页目录项
-    // [KERNEL_BASE >> PDX_SHIFT] = ((uintptr_t)entry_page_table - KERNEL_BASE) + PTE_P + PTE_W
-    for (i = 1; i < page_cnt; i++) {
-        boot_pgdir[(KERNEL_BASE >> PDX_SHIFT) + i] = PADDR(page_table + (i * 1024)) | PTE_P | PTE_W;
+    // 用4M的大页映射[0xc0000000, 0xf8000000)这896M的地址空间，总共224个页目录项，不需要页表。
+    // 同时设置全局位，切换页目录时内核的tlb项不会被刷新
+    for (i = 0; i < KERNEL_MEM_SIZE / PT_SIZE; i++) {
+        boot_pgdir[PDX(KERNEL_BASE) + i] = (i * PT_SIZE) | PTE_P | PTE_W | PTE_PS | PTE_G;
     }
 
     // 将[0,4M)的映射拆除
@@ -249,6 +459,7 @@ void kernel_page_table_init() {
 
     // 自映射，暂时没有完全实现扫描页表的功能：todo
     boot_pgdir[PDX(VPT)] = boot_cr3;
+    lcr3(boot_cr3);
 }
 
 void pmm_init(void) {
@@ -258,6 +469,7 @@ void pmm_init(void) {
     //Then pmm can alloc/free the physical memory. 
     //Now the first_fit/best_fit/worst_fit/buddy_system pmm are available.
     init_pmm_manager();
+    pcp_init();
 
     page_init();
 
@@ -267,6 +479,7 @@ void pmm_init(void) {
 
     //use pmm->check to verify the correctness of the alloc/free function in a pmm
     check_alloc_page();
+    pcp_enabled = true;
 
     struct Page *page = alloc_page();
     uintptr_t kvaddr = (uintptr_t)page2kva(page);
@@ -284,10 +497,14 @@ void pmm_init(void) {
 }
 
 // 从页目录查找页表，如果页表不存在，根据create参数来决定是否创建新的页表
-// 最后在对应的页表中查找到va虚拟地址对应的页表项
+// 最后在对应的页表中查找到va虚拟地址对应的页表项。
+// va在4M大页中时没有页表，返回的是页目录项本身，调用者需要检查PTE_PS
 pte_t *get_pte(pde_t *pgdir, uintptr_t va, bool create) {
     pte_t *ptep = NULL;
     pde_t *pdep = &pgdir[PDX(va)];
+    if (*pdep & PTE_PS) {
+        return pdep;
+    }
     if (!(*pdep & PTE_P)) {
         struct Page *page;
         if (!create || (page = alloc_page()) == NULL) {
@@ -309,6 +526,9 @@ struct Page *get_page(pde_t *pgdir, uintptr_t va, pte_t **ptep_store) {
         *ptep_store = ptep;
     }
     if (ptep != NULL && *ptep & PTE_P) {
+        if (*ptep & PTE_PS) {
+            return pa2page(PDE_ADDR(*ptep) + (va & (PT_SIZE - 1)));
+        }
         return pa2page(*ptep);
     }
     return NULL;
@@ -346,11 +566,99 @@ void page_remove(pde_t *pgdir, uintptr_t va) {
     }
 }
 
+// 用户空间的4M大页(透明大页)中每个4K page都单独计数，大页的映射与1024个pte的映射等价，
+// 因此拆分时只需要申请一个页表，依次填入每个page的地址，page的引用计数不变
+int split_huge_pde(pde_t *pgdir, uintptr_t va) {
+    pde_t *pdep = &pgdir[PDX(va)];
+    assert(va < KERNEL_BASE && (*pdep & PTE_PS));
+    struct Page *page;
+    if ((page = alloc_page()) == NULL) {
+        return -E_NO_MEM;
+    }
+    set_page_ref(page, 1);
+    pte_t *ptep = page2kva(page);
+    uintptr_t pa = PDE_ADDR(*pdep);
+    // PTE_A和PTE_D在pde和pte中的位置相同，swap的时钟算法依赖PTE_A
+    uint32_t perm = (*pdep & (PTE_USER | PTE_SWAP));
+    int i;
+    for (i = 0; i < PTE_ENTRIES; i++) {
+        ptep[i] = (pa + i * PAGE_SIZE) | perm;
+    }
+    *pdep = page2pa(page) | PTE_U | PTE_W | PTE_P;
+    // invlpg大页中的任意地址就会使整个大页的tlb失效
+    tlb_invalidate(pgdir, ROUNDDOWN(va, PT_SIZE));
+    return 0;
+}
+
+// 共享的页表中的page和swap entry只按一个pte计数。需要修改va所在的页表时，
+// 如果还有其他页目录共享这个页表，就复制出一个自己的页表，每个page和swap entry多了一个引用，
+// 两边的pte都去掉PTE_W，之后由写时复制逐页处理；如果只剩自己在使用，直接恢复页目录项的写权限
+int unshare_page_table(pde_t *pgdir, uintptr_t va) {
+    pde_t *pdep = &pgdir[PDX(va)];
+    assert(va < KERNEL_BASE);
+    if ((*pdep & (PTE_P | PTE_W | PTE_PS)) != PTE_P) {
+        return 0;
+    }
+    struct Page *table = pde2page(*pdep);
+    if (page_ref(table) > 1) {
+        struct Page *page;
+        if ((page = alloc_page()) == NULL) {
+            return -E_NO_MEM;
+        }
+        set_page_ref(page, 1);
+        pte_t *from = KVADDR(PDE_ADDR(*pdep)), *to = page2kva(page);
+        int i;
+        for (i = 0; i < PTE_ENTRIES; i++) {
+            if (from[i] & PTE_P) {
+                page_ref_inc(pte2page(from[i]));
+                from[i] &= ~PTE_W;
+            } else if (from[i] != 0) {
+                swap_duplicate(from[i]);
+            }
+            to[i] = from[i];
+        }
+        page_ref_dec(table);
+        *pdep = page2pa(page) | PTE_U | PTE_W | PTE_P;
+    } else {
+        *pdep |= PTE_W;
+    }
+    tlb_invalidate_all(pgdir);
+    return 0;
+}
+
+// 解除整个大页的映射，引用计数减为0的page被释放
+void remove_huge_pde(pde_t *pgdir, uintptr_t va) {
+    pde_t *pdep = &pgdir[PDX(va)];
+    assert(va < KERNEL_BASE && (*pdep & PTE_PS));
+    struct Page *base = pde2page(*pdep);
+    int i, nr_free = 0;
+    for (i = 0; i < PTE_ENTRIES; i++) {
+        // 大页中的page不会在swap中，换出前大页已经被拆分了
+        assert(!PageSwap(base + i));
+        if (page_ref_dec(base + i) == 0) {
+            nr_free++;
+        }
+    }
+    if (nr_free == PTE_ENTRIES) {
+        free_pages(base, PTE_ENTRIES);
+    } else if (nr_free != 0) {
+        // fork之后部分page已经在另一个mm中写时复制过了
+        for (i = 0; i < PTE_ENTRIES; i++) {
+            if (page_ref(base + i) == 0) {
+                free_page(base + i);
+            }
+        }
+    }
+    *pdep = 0;
+    tlb_invalidate(pgdir, ROUNDDOWN(va, PT_SIZE));
+}
+
 int page_insert(pde_t *pgdir, struct Page *page, uintptr_t va, uint32_t perm) {
     pte_t *ptep = get_pte(pgdir, va, 1);
     if (ptep == NULL) {
         return -E_NO_MEM;
     }
+    assert(!(*ptep & PTE_PS));
     page_ref_inc(page);
     if (*ptep & PTE_P) {
         struct Page *p = pte2page(*ptep);
@@ -369,6 +677,32 @@ void tlb_invalidate(pde_t *pgdir, uintptr_t va) {
     if (rcr3() == PADDR(pgdir)) {
         invlpg((void *)va);
     }
+    // 其他cpu上可能也在使用这个页目录(同一个mm的线程)
+    tlb_shootdown((uintptr_t)pgdir);
+}
+
+// 修改了整个页表范围的映射之后，刷新pgdir的所有tlb(全局的内核映射不受影响)
+void tlb_invalidate_all(pde_t *pgdir) {
+    if (rcr3() == PADDR(pgdir)) {
+        lcr3(rcr3());
+    }
+    tlb_shootdown((uintptr_t)pgdir);
+}
+
+// 将[pa, pa + size)的设备内存(lapic、ioapic等)映射到相同的虚拟地址，
+// 这些地址都在KERNEL_TOP之上，需要在创建用户进程之前映射，
+// 这样所有进程的页目录(拷贝自boot_pgdir)中都有这段映射
+void *mmio_map(uintptr_t pa, size_t size) {
+    uintptr_t start = ROUNDDOWN(pa, PAGE_SIZE);
+    uintptr_t end = ROUNDUP(pa + size, PAGE_SIZE);
+    assert(start >= KERNEL_TOP && PDX(start) != PDX(VPT) && end > start);
+    for (; start < end; start += PAGE_SIZE) {
+        pte_t *ptep = get_pte(boot_pgdir, start, 1);
+        assert(ptep != NULL);
+        *ptep = start | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+        invlpg((void *)start);
+    }
+    return (void *)pa;
 }
 
 // 根據va在page_dir這個頁目錄中添加相應的頁表
@@ -433,6 +767,18 @@ void check_pgdir(void) {
     free_page(pa2page(boot_pgdir[0]));
     boot_pgdir[0] = 0;
 
+    // 内核的直接映射都是4M的全局大页，get_pte返回页目录项本身，get_page能找到va所在的page
+    uintptr_t va;
+    for (va = KERNEL_BASE; va < KERNEL_TOP; va += PT_SIZE) {
+        assert((ptep = get_pte(boot_pgdir, va, 0)) == &boot_pgdir[PDX(va)]);
+        assert((*ptep & (PTE_P | PTE_W | PTE_PS | PTE_G)) == (PTE_P | PTE_W | PTE_PS | PTE_G));
+        assert(PDE_ADDR(*ptep) == PADDR(va) && !(*ptep & PTE_U));
+    }
+    p1 = alloc_page();
+    va = (uintptr_t)page2kva(p1) + 123;
+    assert(get_page(boot_pgdir, va, &ptep) == p1 && (*ptep & PTE_PS));
+    free_page(p1);
+
     printk("----------check_pgdir successed!-------------\n");
 }
 
@@ -459,8 +805,8 @@ static int get_pgtable_items(size_t left, size_t right, size_t start,
         if (left_store != NULL) {
             *left_store = start;
         }
-        int perm = (table[start++] & PTE_USER);
-        while (start < right && (table[start] & PTE_USER) == perm) {
+        int perm = (table[start++] & (PTE_USER | PTE_PS));
+        while (start < right && (table[start] & (PTE_USER | PTE_PS)) == perm) {
             start++;
         }
         if (right_store != NULL) {
@@ -475,8 +821,13 @@ void print_pgdir(void) {
     printk("------------------------BEGIN-------------------\n");
     size_t left, right = 0, perm;
     while ((perm = get_pgtable_items(0, PDE_ENTRIES, right, v_pg_dir, &left, &right)) != 0) {
-        printk("PDE(%03x) %08x-%08x %08x %s\n", right - left,
-            left * PT_SIZE, right * PT_SIZE, (right - left) * PT_SIZE, perm2str(perm));
+        printk("PDE(%03x) %08x-%08x %08x %s%s\n", right - left,
+            left * PT_SIZE, right * PT_SIZE, (right - left) * PT_SIZE, perm2str(perm),
+            (perm & PTE_PS) ? " 4M" : "");
+        if (perm & PTE_PS) {
+            // 4M大页没有页表
+            continue;
+        }
         size_t l, r = left * PTE_ENTRIES;
         while ((perm = get_pgtable_items(left * PTE_ENTRIES, right * PTE_ENTRIES, r, v_pg_table, &l, &r)) != 0) {
             printk("  |-- PTE(%05x) %08x-%08x %08x %s\n", r - l,
@@ -484,4 +835,61 @@ void print_pgdir(void) {
         }
     }
     printk("------------------------ END -------------------\n");
-}
\ No newline at end of file
+}
+// 内核memcpy的tlb开销：把物理地址[0, mb M)再用4K的页表映射到KERNEL_TOP之上(这段地址没有使用)，
+// 分别通过4M大页的直接映射和4K页的映射，从每个page中memcpy一小块，统计平均每个page的周期数
+#define TLB_BENCH_BASE      KERNEL_TOP
+#define TLB_BENCH_COPY      64
+#define TLB_BENCH_ROUNDS    16
+
+static uint32_t tlb_bench_round(uintptr_t base, size_t npages) {
+    char buf[TLB_BENCH_COPY];
+    size_t i, j;
+    uint64_t start = read_tsc();
+    for (j = 0; j < TLB_BENCH_ROUNDS; j++) {
+        for (i = 0; i < npages; i++) {
+            memcpy(buf, (void *)(base + i * PAGE_SIZE), TLB_BENCH_COPY);
+        }
+    }
+    uint64_t cycles = read_tsc() - start;
+    do_div(cycles, TLB_BENCH_ROUNDS * npages);
+    return (uint32_t)cycles;
+}
+
+void tlb_benchmark(int mb) {
+    size_t npages = mb * (1024 * 1024 / PAGE_SIZE), i;
+    if (npages > get_npage()) {
+        npages = get_npage();
+    }
+    if (TLB_BENCH_BASE + npages * PAGE_SIZE > VPT) {
+        npages = (VPT - TLB_BENCH_BASE) / PAGE_SIZE;
+    }
+    bool flag;
+    local_intr_save(flag);
+    uintptr_t cr3 = rcr3();
+    // 在boot_pgdir中建立映射，测试期间切换到boot_pgdir
+    lcr3(boot_cr3);
+    for (i = 0; i < npages; i++) {
+        pte_t *ptep = get_pte(boot_pgdir, TLB_BENCH_BASE + i * PAGE_SIZE, 1);
+        if (ptep == NULL) {
+            break;
+        }
+        *ptep = (i * PAGE_SIZE) | PTE_P;
+    }
+    npages = i;
+    lcr3(boot_cr3);
+
+    uint32_t pse_cycles = tlb_bench_round(KERNEL_BASE, npages);
+    uint32_t pte_cycles = tlb_bench_round(TLB_BENCH_BASE, npages);
+
+    uintptr_t va;
+    for (va = TLB_BENCH_BASE; va < TLB_BENCH_BASE + npages * PAGE_SIZE; va += PT_SIZE) {
+        pde_t *pdep = &boot_pgdir[PDX(va)];
+        free_page(pde2page(*pdep));
+        *pdep = 0;
+    }
+    lcr3(cr3);
+    local_intr_restore(flag);
+    printk("tlb_bench: memcpy %d bytes from each of %d pages, 4M pages %u cycles, 4K pages %u cycles.\n",
+        TLB_BENCH_COPY, npages, pse_cycles, pte_cycles);
+}
@@ -19,13 +19,21 @@ struct PmmManager {
 };
 
 void pmm_init(void);
+void gdt_init(void);
 void load_esp0(uintptr_t esp0);
+void load_page_dir(pde_t *page_dir);
 
 pde_t *get_boot_page_dir(void);
 
 struct Page *alloc_pages(size_t n);
 void free_pages(struct Page *base, size_t n);
+struct Page *try_alloc_pages(size_t n);
 size_t nr_free_pages(void);
+struct Page *alloc_cold_page(void);
+void free_cold_page(struct Page *page);
+size_t pcp_drain(void);
+void page_benchmark(int n);
+void tlb_benchmark(int mb);
 
 
 #define alloc_page() alloc_pages(1)
@@ -37,8 +45,14 @@ struct Page *get_page(pde_t *pgdir, uintptr_t va, pte_t **ptep_store);
 void page_remove_pte(pde_t *pgdir, uintptr_t va, pte_t *ptep);
 void page_remove(pde_t *pgdir, uintptr_t va);
 int page_insert(pde_t *pgdir, struct Page *page, uintptr_t va, uint32_t perm);
+int split_huge_pde(pde_t *pgdir, uintptr_t va);
+void remove_huge_pde(pde_t *pgdir, uintptr_t va);
+int unshare_page_table(pde_t *pgdir, uintptr_t va);
 
 void tlb_invalidate(pde_t *pgdir, uintptr_t vaddr);
+void tlb_invalidate_all(pde_t *pgdir);
+
+void *mmio_map(uintptr_t pa, size_t size);
 
 struct Page *page_dir_alloc_page(pde_t *page_dir, uintptr_t va, uint32_t perm);
 
@@ -117,6 +131,11 @@ static inline int page_ref(struct Page *page) {
     return atomic_read(&(page->ref));
 }
 
+// fork时共享给子进程的页表：页目录项去掉了PTE_W，页表page的引用计数为共享它的页目录数
+static inline bool page_table_shared(pde_t pde) {
+    return (pde & (PTE_P | PTE_W | PTE_PS)) == PTE_P && page_ref(pde2page(pde)) > 1;
+}
+
 static inline void set_page_ref(struct Page *page, int ref) {
     atomic_set(&(page->ref), ref);
 }
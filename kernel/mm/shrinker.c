@@ -0,0 +1,63 @@
+#include <shrinker.h>
+#include <sync.h>
+#include <pmm.h>
+#include <stdio.h>
+
+// 所有的shrinker都链接在这个链表上
+static ListEntry shrinker_list;
+
+void shrinker_init(void) {
+    list_init(&shrinker_list);
+}
+
+// 新注册的shrinker放在链表头部，先被调用；
+// slab的shrinker最先注册，因此最后被调用，可以回收其他shrinker释放obj后产生的空slab
+void register_shrinker(Shrinker *shrinker, const char *name, size_t (*shrink)(Shrinker *, size_t)) {
+    shrinker->name = name;
+    shrinker->shrink = shrink;
+    shrinker->nr_calls = shrinker->nr_objs = shrinker->nr_pages = 0;
+    bool flag;
+    local_intr_save(flag);
+    {
+        list_add(&shrinker_list, &(shrinker->shrinker_link));
+    }
+    local_intr_restore(flag);
+}
+
+void unregister_shrinker(Shrinker *shrinker) {
+    bool flag;
+    local_intr_save(flag);
+    {
+        list_del(&(shrinker->shrinker_link));
+    }
+    local_intr_restore(flag);
+}
+
+// 依次调用shrinker，直到释放了nr_pages个page(SHRINK_ALL时调用所有的shrinker并释放全部缓存)，
+// 返回总共释放的page数
+size_t shrink_caches(size_t nr_pages) {
+    size_t total = 0;
+    ListEntry *head = &shrinker_list, *entry = head;
+    while ((entry = list_next(entry)) != head && total < nr_pages) {
+        Shrinker *shrinker = le2shrinker(entry, shrinker_link);
+        size_t nr_free_store = nr_free_pages();
+        size_t target = (nr_pages == SHRINK_ALL) ? SHRINK_ALL : nr_pages - total;
+        shrinker->nr_objs += shrinker->shrink(shrinker, target);
+        size_t nr_free = nr_free_pages();
+        size_t nr_pages = (nr_free > nr_free_store) ? nr_free - nr_free_store : 0;
+        shrinker->nr_calls++;
+        shrinker->nr_pages += nr_pages;
+        total += nr_pages;
+    }
+    return total;
+}
+
+void shrinker_print_info(void) {
+    printk("%-16s %8s %8s %8s\n", "name", "calls", "objs", "pages");
+    ListEntry *head = &shrinker_list, *entry = head;
+    while ((entry = list_next(entry)) != head) {
+        Shrinker *shrinker = le2shrinker(entry, shrinker_link);
+        printk("%-16s %8d %8d %8d\n", shrinker->name, shrinker->nr_calls,
+            shrinker->nr_objs, shrinker->nr_pages);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef __KERNEL_MM_SHRINKER_H__
+#define __KERNEL_MM_SHRINKER_H__
+
+#include <types.h>
+#include <list.h>
+
+// 可回收缓存的回收器，内存紧张时由kswapd调用，释放暂时不用的缓存
+typedef struct shrinker {
+    const char *name;
+    // 释放缓存，尽量释放出nr_pages个page，返回释放的对象个数(单位由各个缓存自己决定)
+    size_t (*shrink)(struct shrinker *shrinker, size_t nr_pages);
+    ListEntry shrinker_link;
+    size_t nr_calls;            // 被调用的次数
+    size_t nr_objs;             // 累计释放的对象个数
+    size_t nr_pages;            // 累计释放的page数，由调用前后空闲page数的差值得到
+} Shrinker;
+
+#define le2shrinker(le, member)     \
+    container_of((le), Shrinker, member)
+
+// 释放所有可回收的缓存，自检时用来得到确定的空闲page数
+#define SHRINK_ALL      ((size_t)-1)
+
+void shrinker_init(void);
+void register_shrinker(Shrinker *shrinker, const char *name, size_t (*shrink)(Shrinker *, size_t));
+void unregister_shrinker(Shrinker *shrinker);
+size_t shrink_caches(size_t nr_pages);
+void shrinker_print_info(void);
+
+#endif // __KERNEL_MM_SHRINKER_H__
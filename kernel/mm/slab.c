@@ -8,6 +8,10 @@
 #include <buddy_pmm.h>
 #include <stdio.h>
 #include <rbtree.h>
+#include <shrinker.h>
+#include <string.h>
+#include <cpu.h>
+#include <x86.h>
 
 /* The slab allocator is base on a paper, and the paper can be download from 
    http://citeseer.ist.psu.edu/bonwick94slab.html 
@@ -28,9 +32,32 @@ typedef struct slab_s {
 #define le2slab(le, member)             \
     container_of((le), slab_t, member)
 
-typedef struct kmem_cache_s {
+// Bonwick的magazine层：每个cpu缓存两个magazine(obj的LIFO栈)，
+// 常见的分配和释放只在本cpu的magazine上进行，不需要访问slab链表；
+// 两个magazine都空(满)时才与cache的depot交换满(空)的magazine
+#define MAGAZINE_SIZE       14  // 每个magazine缓存的obj个数
+#define MAGAZINE_DEPOT_MAX  8   // depot中最多保留的满magazine个数，超过时直接还给slab
+
+typedef struct magazine_s {
+    ListEntry magazine_link;    // 链接到depot的full或empty链表
+    int rounds;                 // magazine中obj的个数
+    void *objs[MAGAZINE_SIZE];
+} magazine_t;
+
+#define le2magazine(le, member)         \
+    container_of((le), magazine_t, member)
+
+typedef struct cpu_cache_s {
+    magazine_t *loaded;         // 当前使用的magazine
+    magazine_t *previous;       // 上一个magazine，总是满的或者空的
+} cpu_cache_t;
+
+struct kmem_cache_s {
     ListEntry slabs_full;    // 所有obj都被分配出去的slab链接在此链表
     ListEntry slabs_partial;  // slab的obj没有全部分配出去时挂接在该链表
+    ListEntry slabs_free;     // obj都没有被使用的slab，暂时保留以便再次使用
+    size_t free_count;        // slabs_free中slab的个数
+    size_t free_limit;        // slabs_free中最多保留的slab个数，超过时直接释放
     size_t objsize; // slab中obj的大小（以字节为单位）
     size_t num;     // 每个slab中obj的个数
     size_t offset;  // slab中第一个obj的偏移量
@@ -39,48 +66,121 @@ typedef struct kmem_cache_s {
     size_t page_order;  // 每个slab使用的page数目（page_order为2的幂，即page数为：2^page_order）
 
     struct kmem_cache_s *slab_cachep;
-} kmem_cache_t;
+
+    char name[KMEM_CACHE_NAME_LEN];
+    void (*ctor)(void *objp);   // obj的构造函数，新建slab时对每个obj调用一次，释放obj时调用者要将其恢复到构造后的状态
+    ListEntry cache_link;       // 链接到cache_chain
+
+    bool no_magazine;           // 不使用magazine层，直接从slab分配
+    bool no_reclaim;            // 新建slab时只从伙伴系统取page，不回收内存也不睡眠，取不到时直接失败
+    cpu_cache_t cpu_cache[NCPU];
+    ListEntry depot_full;       // depot中满的magazine
+    ListEntry depot_empty;      // depot中空的magazine
+    size_t depot_full_count;
+};
+
+#define le2cache(le, member)            \
+    container_of((le), kmem_cache_t, member)
 
 #define MIN_SIZE_ORDER      5   // slab中obj的最小值，也就是 2^5 = 32B
 #define MAX_SIZE_ORDER      17  // slab中obj的最大值，也就是 2^17 = 128K
 #define SLAB_CACHE_NUM      (MAX_SIZE_ORDER - MIN_SIZE_ORDER + 1)   // 总共有13个不同obj大小的slab缓冲区
 
-static kmem_cache_t slab_cache[SLAB_CACHE_NUM];
+// slab中obj默认的对齐值，最好为2^n
+#define SLAB_DEFAULT_ALIGN  16
+// 每个cache的slabs_free中最多保留的page数
+#define SLAB_FREE_PAGES     8
 
-static void init_kmem_cache(kmem_cache_t *cachep, size_t objsize, size_t align);
+// kmalloc使用的按2的幂划分大小的cache
+static kmem_cache_t slab_cache[SLAB_CACHE_NUM];
+// 用于分配kmem_cache_create创建的cache结构体本身
+static kmem_cache_t cache_cache;
+// 用于分配magazine
+static kmem_cache_t magazine_cache;
+// check_slab检查slab链表的状态，完成之前不能使用magazine
+static bool magazine_enabled = false;
+// 所有的cache都链接在这个链表上
+static ListEntry cache_chain;
+
+static Shrinker slab_shrinker;
+
+static void init_kmem_cache(kmem_cache_t *cachep, const char *name, size_t objsize,
+    size_t align, void (*ctor)(void *));
 void check_slab(void);
+static size_t slab_shrink(Shrinker *shrinker, size_t nr_pages);
 
 
 
 void slab_init(void) {
     size_t i;
-    // slab中obj的对齐值，最好为2^n
-    size_t align = 16;
+    char name[KMEM_CACHE_NAME_LEN];
+    list_init(&cache_chain);
+    init_kmem_cache(&cache_cache, "kmem_cache", sizeof(kmem_cache_t), SLAB_DEFAULT_ALIGN, NULL);
+    init_kmem_cache(&magazine_cache, "magazine", sizeof(magazine_t), SLAB_DEFAULT_ALIGN, NULL);
+    cache_cache.no_magazine = magazine_cache.no_magazine = true;
+    // magazine在kmem_cache_free中申请，释放路径上不能回收内存(kswapd回收缓存时也会释放obj)
+    magazine_cache.no_reclaim = true;
     for (i = 0; i < SLAB_CACHE_NUM; i++) {
-        init_kmem_cache(slab_cache + i, 1 << (i + MIN_SIZE_ORDER), align);
+        snprintf(name, sizeof(name), "size-%d", 1 << (i + MIN_SIZE_ORDER));
+        init_kmem_cache(slab_cache + i, name, 1 << (i + MIN_SIZE_ORDER), SLAB_DEFAULT_ALIGN, NULL);
     }
     check_slab();
+    magazine_enabled = true;
     check_rbtree();
+
+    shrinker_init();
+    register_shrinker(&slab_shrinker, "slab", slab_shrink);
+}
+
+// magazine中缓存的obj数
+static size_t kmem_cache_cached(kmem_cache_t *cachep) {
+    size_t cached = 0;
+    int i;
+    for (i = 0; i < NCPU; i++) {
+        cpu_cache_t *cc = cachep->cpu_cache + i;
+        if (cc->loaded != NULL) {
+            cached += cc->loaded->rounds;
+        }
+        if (cc->previous != NULL) {
+            cached += cc->previous->rounds;
+        }
+    }
+    cached += cachep->depot_full_count * MAGAZINE_SIZE;
+    return cached;
+}
+
+// 统计cache中已分配的obj数(包括缓存在magazine中的)、obj总数以及slab数
+static void kmem_cache_usage(kmem_cache_t *cachep, size_t *active_store,
+    size_t *total_store, size_t *slabs_store) {
+    size_t active = 0, nr_slabs = 0;
+    ListEntry *head, *entry;
+    head = entry = &(cachep->slabs_full);
+    while ((entry = list_next(entry)) != head) {
+        active += cachep->num;
+        nr_slabs++;
+    }
+    head = entry = &(cachep->slabs_partial);
+    while ((entry = list_next(entry)) != head) {
+        active += le2slab(entry, slab_link)->inuse;
+        nr_slabs++;
+    }
+    nr_slabs += cachep->free_count;
+    *active_store = active;
+    *total_store = nr_slabs * cachep->num;
+    *slabs_store = nr_slabs;
 }
 
 size_t slab_allocated(void) {
     size_t total = 0;
-    int i;
+    size_t active, nr_objs, nr_slabs;
     bool flag;
     local_intr_save(flag);
     {
-        for (i = 0; i < SLAB_CACHE_NUM; i++) {
-            kmem_cache_t *cachep = slab_cache + i;
-            ListEntry *head, *entry;
-            head = entry = &(cachep->slabs_full);
-            while ((entry = list_next(entry)) != head) {
-                total += cachep->num * cachep->objsize;
-            }
-            head = entry = &(cachep->slabs_partial);
-            while ((entry = list_next(entry)) != head) {
-                slab_t *slabp = le2slab(entry, slab_link);
-                total += cachep->objsize * slabp->inuse;
-            }
+        ListEntry *head = &cache_chain, *entry = head;
+        while ((entry = list_next(entry)) != head) {
+            kmem_cache_t *cachep = le2cache(entry, cache_link);
+            kmem_cache_usage(cachep, &active, &nr_objs, &nr_slabs);
+            total += cachep->objsize * active;
         }
     }
     local_intr_restore(flag);
@@ -88,6 +188,31 @@ size_t slab_allocated(void) {
     return total;
 }
 
+// 打印每个cache的使用情况
+void slab_print_info(void) {
+    size_t active, nr_objs, nr_slabs, cached;
+    size_t total_pages = 0;
+    bool flag;
+    printk("%-16s %8s %8s %8s %8s %6s %6s\n", "name", "objsize", "active", "cached", "objs", "slabs", "pages");
+    local_intr_save(flag);
+    {
+        ListEntry *head = &cache_chain, *entry = head;
+        while ((entry = list_next(entry)) != head) {
+            kmem_cache_t *cachep = le2cache(entry, cache_link);
+            kmem_cache_usage(cachep, &active, &nr_objs, &nr_slabs);
+            if (nr_slabs == 0) {
+                continue;
+            }
+            cached = kmem_cache_cached(cachep);
+            printk("%-16s %8d %8d %8d %8d %6d %6d\n", cachep->name, cachep->objsize,
+                active - cached, cached, nr_objs, nr_slabs, nr_slabs << cachep->page_order);
+            total_pages += nr_slabs << cachep->page_order;
+        }
+    }
+    local_intr_restore(flag);
+    printk("total: %d pages, %d bytes allocated.\n", total_pages, slab_allocated());
+}
+
 // slab控制字段的大小，控制字段包括slab结构体自身大小，以及用于着色的部分，最后再对齐
 static size_t slab_mgmt_size(size_t num, size_t align) {
     return ROUNDUP(sizeof(slab_t) + num * sizeof(kmem_bufctl_t), align);
@@ -173,9 +298,21 @@ static inline size_t get_order(size_t n) {
 }
 
 
-static void init_kmem_cache(kmem_cache_t *cachep, size_t objsize, size_t align) {
+static void init_kmem_cache(kmem_cache_t *cachep, const char *name, size_t objsize,
+    size_t align, void (*ctor)(void *)) {
     list_init(&(cachep->slabs_full));
     list_init(&(cachep->slabs_partial));
+    list_init(&(cachep->slabs_free));
+    cachep->free_count = 0;
+    memset(cachep->name, 0, sizeof(cachep->name));
+    strncpy(cachep->name, name, sizeof(cachep->name) - 1);
+    cachep->ctor = ctor;
+    cachep->no_magazine = false;
+    cachep->no_reclaim = false;
+    memset(cachep->cpu_cache, 0, sizeof(cachep->cpu_cache));
+    list_init(&(cachep->depot_full));
+    list_init(&(cachep->depot_empty));
+    cachep->depot_full_count = 0;
 
     objsize = ROUNDUP(objsize, align);
     cachep->objsize = objsize;
@@ -189,6 +326,11 @@ static void init_kmem_cache(kmem_cache_t *cachep, size_t objsize, size_t align)
     calculate_slab_order(cachep, objsize, align, cachep->off_slab, &left_over);
 
     assert(cachep->num > 0);
+    // 每个cache最多保留SLAB_FREE_PAGES个page的空slab
+    cachep->free_limit = (SLAB_FREE_PAGES >> cachep->page_order);
+    if (cachep->free_limit == 0) {
+        cachep->free_limit = 1;
+    }
 
     size_t mgmt_size = slab_mgmt_size(cachep->num, align);
 
@@ -200,9 +342,30 @@ static void init_kmem_cache(kmem_cache_t *cachep, size_t objsize, size_t align)
         cachep->offset = mgmt_size;
         cachep->slab_cachep = NULL;
     }
+
+    bool flag;
+    local_intr_save(flag);
+    {
+        list_add_before(&cache_chain, &(cachep->cache_link));
+    }
+    local_intr_restore(flag);
+}
+
+// 创建一个存放size字节大小obj的cache，align为0时使用默认的对齐值
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, size_t align, void (*ctor)(void *)) {
+    assert(size > 0 && size <= (1 << MAX_SIZE_ORDER));
+    if (align == 0) {
+        align = SLAB_DEFAULT_ALIGN;
+    }
+    kmem_cache_t *cachep;
+    if ((cachep = kmem_cache_alloc(&cache_cache)) != NULL) {
+        init_kmem_cache(cachep, name, size, align, ctor);
+    }
+    return cachep;
 }
 
-static void *kmem_cache_alloc(kmem_cache_t *cachep);
+static void *kmem_cache_alloc_slab(kmem_cache_t *cachep);
+static void kmem_cache_free_slab(kmem_cache_t *cachep, void *objp);
 
 #define slab_bufctl(slabp)  \
     ((kmem_bufctl_t *)(((slab_t *)(slabp)) + 1))
@@ -214,7 +377,7 @@ static slab_t *kmem_cache_slabmgmt(kmem_cache_t *cachep, struct Page *page) {
     slab_t *slabp = NULL;
 
     if (cachep->off_slab) {
-        if ((slabp = kmem_cache_alloc(cachep->slab_cachep)) == NULL) {
+        if ((slabp = kmem_cache_alloc_slab(cachep->slab_cachep)) == NULL) {
             return NULL;
         }
     } else {
@@ -248,7 +411,12 @@ static slab_t *kmem_cache_slabmgmt(kmem_cache_t *cachep, struct Page *page) {
 // 项cache中添加一个新的slab
 static bool kmem_cache_grow(kmem_cache_t *cachep) {
     // 该cache管理的slab大小为(1 << page_order)
-    struct Page *page = alloc_pages(1 << cachep->page_order);
+    struct Page *page;
+    if (cachep->no_reclaim) {
+        page = try_alloc_pages(1 << cachep->page_order);
+    } else {
+        page = alloc_pages(1 << cachep->page_order);
+    }
     if (page == NULL) {
         goto failed;
     }
@@ -279,6 +447,11 @@ static bool kmem_cache_grow(kmem_cache_t *cachep) {
     slab_bufctl(slabp)[cachep->num - 1] = BUFCTL_END;
     // 第一个可用obj的索引设置为0，也就是从第0个obj开始申请obj
     slabp->free = 0; 
+    if (cachep->ctor != NULL) {
+        for (i = 0; i < cachep->num; i++) {
+            cachep->ctor(slabp->s_mem + i * cachep->objsize);
+        }
+    }
     bool flag;
     local_intr_save(flag);
     {
@@ -306,14 +479,22 @@ static void *kmem_cache_alloc_one(kmem_cache_t *cachep, slab_t *slabp) {
     return objp;
 }
 
-static void *kmem_cache_alloc(kmem_cache_t *cachep) {
+// 直接从slab中分配obj
+static void *kmem_cache_alloc_slab(kmem_cache_t *cachep) {
     void *objp;
     bool flag;
 
 try_again:
     local_intr_save(flag);
     if (list_empty(&(cachep->slabs_partial))) {
-        goto alloc_new_slab;
+        if (list_empty(&(cachep->slabs_free))) {
+            goto alloc_new_slab;
+        }
+        // 重新使用保留的空slab
+        ListEntry *entry = list_next(&(cachep->slabs_free));
+        list_del(entry);
+        list_add(&(cachep->slabs_partial), entry);
+        cachep->free_count--;
     }
     slab_t *slabp = le2slab(list_next(&(cachep->slabs_partial)), slab_link);
     objp = kmem_cache_alloc_one(cachep, slabp);
@@ -331,15 +512,13 @@ alloc_new_slab:
 
 void *kmalloc(size_t size) {
     assert(size > 0);
-    size_t order = get_order(size);
-    if (order > MAX_SIZE_ORDER) {
+    if (size > (1 << MAX_SIZE_ORDER)) {
         return NULL;
     }
+    size_t order = get_order(size);
     return kmem_cache_alloc(slab_cache + (order - MIN_SIZE_ORDER));
 }
 
-static void kmem_cache_free(kmem_cache_t *cachep, void *obj);
-
 static void kmem_slab_destory(kmem_cache_t *cachep, slab_t *slabp) {
     struct Page *page = kva2page(slabp->s_mem - slabp->offset);
 
@@ -354,7 +533,7 @@ static void kmem_slab_destory(kmem_cache_t *cachep, slab_t *slabp) {
     free_pages(page, 1 << cachep->page_order);
 
     if (cachep->off_slab) {
-        kmem_cache_free(cachep->slab_cachep, slabp);
+        kmem_cache_free_slab(cachep->slab_cachep, slabp);
     }
 }
 
@@ -367,11 +546,15 @@ static void kmem_cache_free_one(kmem_cache_t *cachep, slab_t *slabp, void *objp)
     slabp->inuse--;
 
     if (slabp->inuse == 0) {
-        // 如果slab中的obj没有被使用，就释放这个slab
-        // 我们可以优化一下：在slab中的obj没有被使用时，
-        // 暂时将其放入empty链表，等待以后使用（目前没有empty这个链表，需要添加）
+        // slab中的obj都没有被使用了，在水位以下时暂时放入slabs_free等待以后使用，
+        // 避免反复申请和释放page，多余的空slab由shrinker回收
         list_del(&(slabp->slab_link));
-        kmem_slab_destory(cachep, slabp);
+        if (cachep->free_count < cachep->free_limit) {
+            list_add(&(cachep->slabs_free), &(slabp->slab_link));
+            cachep->free_count++;
+        } else {
+            kmem_slab_destory(cachep, slabp);
+        }
     } else if (slabp->inuse == cachep->num - 1) {
         // 说明之前满了，现在空出一个obj出来了
         list_del(&(slabp->slab_link));
@@ -385,7 +568,8 @@ static void kmem_cache_free_one(kmem_cache_t *cachep, slab_t *slabp, void *objp)
 #define GET_PAGE_SLAB(page)    \
     (slab_t *)((page)->page_link.prev)
   
-static void kmem_cache_free(kmem_cache_t *cachep, void *objp) {
+// 直接把obj还给slab
+static void kmem_cache_free_slab(kmem_cache_t *cachep, void *objp) {
     bool flag;
     struct Page *page = kva2page(objp);
     if (!PageSlab(page)) {
@@ -399,6 +583,264 @@ static void kmem_cache_free(kmem_cache_t *cachep, void *objp) {
     local_intr_restore(flag);
 }
 
+static magazine_t *magazine_alloc(void) {
+    magazine_t *mag = kmem_cache_alloc_slab(&magazine_cache);
+    if (mag != NULL) {
+        mag->rounds = 0;
+    }
+    return mag;
+}
+
+// 把magazine中的obj全部还给slab
+static void magazine_flush(kmem_cache_t *cachep, magazine_t *mag) {
+    while (mag->rounds > 0) {
+        kmem_cache_free_slab(cachep, mag->objs[--mag->rounds]);
+    }
+}
+
+// 保证loaded中至少有一个obj，depot中也没有满的magazine时返回false
+static bool magazine_alloc_ready(kmem_cache_t *cachep, cpu_cache_t *cc) {
+    magazine_t *mag;
+    if (cc->loaded != NULL && cc->loaded->rounds > 0) {
+        return true;
+    }
+    if (cc->previous != NULL && cc->previous->rounds > 0) {
+        mag = cc->loaded;
+        cc->loaded = cc->previous;
+        cc->previous = mag;
+        return true;
+    }
+    if (list_empty(&(cachep->depot_full))) {
+        return false;
+    }
+    mag = le2magazine(list_next(&(cachep->depot_full)), magazine_link);
+    list_del(&(mag->magazine_link));
+    cachep->depot_full_count--;
+    // loaded和previous都是空的，previous放回depot
+    if (cc->previous != NULL) {
+        list_add(&(cachep->depot_empty), &(cc->previous->magazine_link));
+    }
+    cc->previous = cc->loaded;
+    cc->loaded = mag;
+    return true;
+}
+
+// 保证loaded中至少有一个空位。需要新的空magazine而depot中没有时，使用*emptyp，
+// *emptyp也为NULL时返回false，由调用者开中断申请一个之后再试
+static bool magazine_free_ready(kmem_cache_t *cachep, cpu_cache_t *cc, magazine_t **emptyp) {
+    magazine_t *mag;
+    if (cc->loaded != NULL && cc->loaded->rounds < MAGAZINE_SIZE) {
+        return true;
+    }
+    if (cc->previous != NULL && cc->previous->rounds < MAGAZINE_SIZE) {
+        mag = cc->loaded;
+        cc->loaded = cc->previous;
+        cc->previous = mag;
+        return true;
+    }
+    if (cc->previous != NULL && cachep->depot_full_count >= MAGAZINE_DEPOT_MAX) {
+        // depot中的满magazine已经足够多了，把previous中的obj还给slab，作为空magazine使用
+        magazine_flush(cachep, cc->previous);
+        mag = cc->previous;
+    } else {
+        if (!list_empty(&(cachep->depot_empty))) {
+            mag = le2magazine(list_next(&(cachep->depot_empty)), magazine_link);
+            list_del(&(mag->magazine_link));
+        } else if ((mag = *emptyp) != NULL) {
+            *emptyp = NULL;
+        } else {
+            return false;
+        }
+        if (cc->previous != NULL) {
+            list_add(&(cachep->depot_full), &(cc->previous->magazine_link));
+            cachep->depot_full_count++;
+        }
+    }
+    cc->previous = cc->loaded;
+    cc->loaded = mag;
+    return true;
+}
+
+void *kmem_cache_alloc(kmem_cache_t *cachep) {
+    if (magazine_enabled && !cachep->no_magazine) {
+        void *objp = NULL;
+        bool flag;
+        local_intr_save(flag);
+        {
+            cpu_cache_t *cc = cachep->cpu_cache + this_cpu()->id;
+            if (magazine_alloc_ready(cachep, cc)) {
+                objp = cc->loaded->objs[--cc->loaded->rounds];
+            }
+        }
+        local_intr_restore(flag);
+        if (objp != NULL) {
+            return objp;
+        }
+    }
+    return kmem_cache_alloc_slab(cachep);
+}
+
+void kmem_cache_free(kmem_cache_t *cachep, void *objp) {
+    if (magazine_enabled && !cachep->no_magazine) {
+        magazine_t *empty = NULL;
+        bool flag, done;
+        while (1) {
+            local_intr_save(flag);
+            {
+                cpu_cache_t *cc = cachep->cpu_cache + this_cpu()->id;
+                if ((done = magazine_free_ready(cachep, cc, &empty))) {
+                    cc->loaded->objs[cc->loaded->rounds++] = objp;
+                }
+            }
+            local_intr_restore(flag);
+            if (done) {
+                if (empty != NULL) {
+                    // 开中断申请magazine期间，其他路径已经准备好了空位
+                    kmem_cache_free_slab(&magazine_cache, empty);
+                }
+                return;
+            }
+            // magazine_cache不回收内存，内存不足时申请失败，obj直接还给slab
+            if (empty != NULL || (empty = magazine_alloc()) == NULL) {
+                break;
+            }
+        }
+    }
+    kmem_cache_free_slab(cachep, objp);
+}
+
+// 把depot中满的magazine里的obj还给slab，并释放depot中所有的magazine
+static void magazine_depot_flush(kmem_cache_t *cachep) {
+    magazine_t *mag;
+    while (!list_empty(&(cachep->depot_full))) {
+        mag = le2magazine(list_next(&(cachep->depot_full)), magazine_link);
+        list_del(&(mag->magazine_link));
+        magazine_flush(cachep, mag);
+        kmem_cache_free_slab(&magazine_cache, mag);
+    }
+    cachep->depot_full_count = 0;
+    while (!list_empty(&(cachep->depot_empty))) {
+        mag = le2magazine(list_next(&(cachep->depot_empty)), magazine_link);
+        list_del(&(mag->magazine_link));
+        kmem_cache_free_slab(&magazine_cache, mag);
+    }
+}
+
+// 释放slabs_free中保留的空slab，释放了nr_pages个page后停止，返回释放的page数。
+// off_slab的控制结构释放后也可能产生新的空slab，而它们所在的cache(kmalloc的小obj cache)
+// 在cache_chain中排在前面，因此从后往前释放
+static size_t slab_free_empty(size_t nr_pages) {
+    size_t freed = 0;
+    ListEntry *head = &cache_chain, *entry = head;
+    while ((entry = list_prev(entry)) != head && freed < nr_pages) {
+        kmem_cache_t *cachep = le2cache(entry, cache_link);
+        while (!list_empty(&(cachep->slabs_free)) && freed < nr_pages) {
+            slab_t *slabp = le2slab(list_next(&(cachep->slabs_free)), slab_link);
+            list_del(&(slabp->slab_link));
+            cachep->free_count--;
+            kmem_slab_destory(cachep, slabp);
+            freed += (1 << cachep->page_order);
+        }
+    }
+    return freed;
+}
+
+// 把所有magazine中缓存的obj还给slab，并释放magazine本身，然后释放所有空的slab，返回释放的page数
+size_t slab_drain(void) {
+    bool flag;
+    int i;
+    size_t nr_pages = 0;
+    magazine_t *mag;
+    local_intr_save(flag);
+    {
+        ListEntry *head = &cache_chain, *entry = head;
+        while ((entry = list_next(entry)) != head) {
+            kmem_cache_t *cachep = le2cache(entry, cache_link);
+            if (cachep->no_magazine) {
+                continue;
+            }
+            for (i = 0; i < NCPU; i++) {
+                cpu_cache_t *cc = cachep->cpu_cache + i;
+                if ((mag = cc->loaded) != NULL) {
+                    magazine_flush(cachep, mag);
+                    kmem_cache_free_slab(&magazine_cache, mag);
+                }
+                if ((mag = cc->previous) != NULL) {
+                    magazine_flush(cachep, mag);
+                    kmem_cache_free_slab(&magazine_cache, mag);
+                }
+                cc->loaded = cc->previous = NULL;
+            }
+            magazine_depot_flush(cachep);
+        }
+        // magazine都释放之后再释放空slab
+        nr_pages = slab_free_empty(SHRINK_ALL);
+    }
+    local_intr_restore(flag);
+    return nr_pages;
+}
+
+// 内存紧张时按需要释放的page数回收：先释放保留的空slab，不够时再把depot中的magazine还给slab，
+// 然后释放因此变空的slab。各个cpu正在使用的magazine不动，magazine和空slab的水位在压力过去后仍然有效
+static size_t slab_shrink(Shrinker *shrinker, size_t nr_pages) {
+    if (nr_pages == SHRINK_ALL) {
+        return slab_drain();
+    }
+    bool flag;
+    size_t freed;
+    local_intr_save(flag);
+    {
+        if ((freed = slab_free_empty(nr_pages)) < nr_pages) {
+            ListEntry *head = &cache_chain, *entry = head;
+            while ((entry = list_next(entry)) != head) {
+                kmem_cache_t *cachep = le2cache(entry, cache_link);
+                if (!cachep->no_magazine) {
+                    magazine_depot_flush(cachep);
+                }
+            }
+            freed += slab_free_empty(nr_pages - freed);
+        }
+    }
+    local_intr_restore(flag);
+    return freed;
+}
+
+// kmalloc/kfree的吞吐量：分别在使用和不使用magazine时，
+// 反复申请并释放n次(单个以及每批32个)64字节的obj，统计平均每次的周期数
+#define SLAB_BENCH_BATCH    32
+
+static uint32_t slab_bench_round(int n) {
+    void *objs[SLAB_BENCH_BATCH];
+    int i, j;
+    uint64_t start = read_tsc();
+    for (i = 0; i < n; i++) {
+        kfree(kmalloc(64));
+    }
+    for (i = 0; i < n; i += SLAB_BENCH_BATCH) {
+        for (j = 0; j < SLAB_BENCH_BATCH; j++) {
+            objs[j] = kmalloc(64);
+        }
+        for (j = 0; j < SLAB_BENCH_BATCH; j++) {
+            kfree(objs[j]);
+        }
+    }
+    uint64_t cycles = read_tsc() - start;
+    // 每次kmalloc加kfree
+    do_div(cycles, 2 * ROUNDUP(n, SLAB_BENCH_BATCH));
+    return (uint32_t)cycles;
+}
+
+void slab_benchmark(int n) {
+    bool enabled = magazine_enabled;
+    magazine_enabled = false;
+    uint32_t slab_cycles = slab_bench_round(n);
+    magazine_enabled = true;
+    uint32_t magazine_cycles = slab_bench_round(n);
+    magazine_enabled = enabled;
+    printk("slab_bench: %d kmalloc/kfree pairs, slab lists %u cycles, magazines %u cycles.\n",
+        n, slab_cycles, magazine_cycles);
+}
+
 void kfree(void *objp) {
     kmem_cache_free(GET_PAGE_CACHE(kva2page(objp)), objp);
 }
@@ -410,6 +852,7 @@ static inline void check_slab_empty(void) {
         kmem_cache_t *cachep = slab_cache + i;
         assert(list_empty(&(cachep->slabs_full)));
         assert(list_empty(&(cachep->slabs_partial)));
+        assert(list_empty(&(cachep->slabs_free)));
     }
 }
 
@@ -445,7 +888,7 @@ void check_slab(void) {
     p1 = p0;
     // cache0中slab的大小为order_size个page
     order_size = (1 << cachep0->page_order);
-    for (i = 0; i < cachep0->page_order; i++, p1++) {
+    for (i = 0; i < order_size; i++, p1++) {
         // cache中的page都设置了slab标志
         assert(PageSlab(p1));
         // 所有page都指向了page所在的cache和slab
@@ -460,17 +903,60 @@ void check_slab(void) {
     kfree(v0);
     // 释放v0，那么slabp0的下一个可用obj索引为0
     assert(slabp0->free == 0);
-    // 释放v1，那么slabp0的下一个可用obj索引为1（但是由于这个slab没有obj被使用，因此会被释放掉）
+    // 释放v1，slabp0中没有obj被使用了，在水位以下，保留在slabs_free中而不是释放掉
     kfree(v1);
-    // slabp0已经被释放
     assert(list_empty(&(cachep0->slabs_partial)));
+    assert(cachep0->free_limit >= 1 && cachep0->free_count == 1);
+    assert(list_next(&(cachep0->slabs_free)) == &(slabp0->slab_link) &&
+        list_next(&(slabp0->slab_link)) == &(cachep0->slabs_free));
+    assert(slabp0->inuse == 0);
+
+    // 保留的slab中的page仍然属于这个cache
+    for (i = 0, p1 = p0; i < order_size; i++, p1++) {
+        assert(PageSlab(p1) && GET_PAGE_CACHE(p1) == cachep0 && GET_PAGE_SLAB(p1) == slabp0);
+    }
 
-    // slabp0中的所有page都被释放掉了，因此之前申请的page不再有slab标志
-    for (i = 0; i < cachep0->page_order; i++, p0++) {
-        assert(!PageSlab(p0));
+    // 再次申请时重新使用保留的slabp0，不申请新的page
+    size_t nr_free_pages_reuse = nr_free_pages();
+    assert((v0 = kmalloc(16)) != NULL && kva2page(v0) == p0);
+    assert(nr_free_pages() == nr_free_pages_reuse);
+    assert(cachep0->free_count == 0 && list_empty(&(cachep0->slabs_free)));
+    assert(list_next(&(cachep0->slabs_partial)) == &(slabp0->slab_link));
+    kfree(v0);
+    assert(cachep0->free_count == 1);
+
+    // 空slab超过free_limit之后直接释放：每个slab只申请一个obj，一共free_limit + 1个slab，
+    // 第一个obj放在已经保留的slabp0中，其余每个obj都要新建一个slab
+    // 同一个slab中的obj用obj的第一个字链接起来
+    void **objs[SLAB_FREE_PAGES + 1];
+    size_t nr_slabs = cachep0->free_limit + 1;
+    assert(nr_slabs <= SLAB_FREE_PAGES + 1);
+    for (i = 0; i < nr_slabs; i++) {
+        assert((objs[i] = kmalloc(16)) != NULL);
+        *objs[i] = NULL;
+        slab_t *slabp = le2slab(list_next(&(cachep0->slabs_partial)), slab_link);
+        // 把这个slab中剩下的obj都占满，下一个obj只能在新的slab中申请
+        while (slabp->inuse < cachep0->num) {
+            void **objp = kmalloc(16);
+            *objp = objs[i];
+            objs[i] = objp;
+        }
+    }
+    assert(cachep0->free_count == 0 && list_empty(&(cachep0->slabs_partial)));
+    nr_free_pages_reuse = nr_free_pages();
+    for (i = 0; i < nr_slabs; i++) {
+        while (objs[i] != NULL) {
+            void **next = *objs[i];
+            kfree(objs[i]);
+            objs[i] = next;
+        }
     }
+    // 只保留了free_limit个空slab，多出来的一个被释放
+    assert(cachep0->free_count == cachep0->free_limit);
+    assert(nr_free_pages() == nr_free_pages_reuse + order_size);
+    assert(list_empty(&(cachep0->slabs_full)) && list_empty(&(cachep0->slabs_partial)));
 
-    // 申请一个obj，在obj大小为32的cache上申请
+    // 申请一个obj，在obj大小为32的cache上申请，使用的是保留的空slab
     v0 = kmalloc(16);
     // obj大小为32的cache的slabs_partial链表非空
     assert(!list_empty(&(cachep0->slabs_partial)));
@@ -581,6 +1067,8 @@ void check_slab(void) {
 
 check_pass:
     // check_rb_tree();
+    // 释放检查过程中保留下来的空slab
+    slab_drain();
     check_slab_empty();
     assert(slab_allocated() == 0);
     assert(slab_allocated() == slab_allocated_store);
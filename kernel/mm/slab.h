@@ -5,11 +5,22 @@
 
 #define KMALLOC_MAX_ORDER   10
 
+#define KMEM_CACHE_NAME_LEN 16
+
+typedef struct kmem_cache_s kmem_cache_t;
+
 void slab_init(void);
 
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, size_t align, void (*ctor)(void *));
+void *kmem_cache_alloc(kmem_cache_t *cachep);
+void kmem_cache_free(kmem_cache_t *cachep, void *objp);
+
 void *kmalloc(size_t n);
 void kfree(void *p);
 
 size_t slab_allocated(void);
+void slab_print_info(void);
+size_t slab_drain(void);
+void slab_benchmark(int n);
 
 #endif // __KERNEL_MM_SLAB_H__
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <list.h>
 #include <stdlib.h>
 #include <slab.h>
+#include <shrinker.h>
 #include <error.h>
 #include <swapfs.h>
 #include <string.h>
@@ -16,6 +17,7 @@
 #include <wait.h>
 // #include <sync.h>
 #include <semaphore.h>
+#include <buddy_pmm.h>
 
 size_t max_swap_offset;
 
@@ -57,6 +59,10 @@ static Semaphore swap_in_sem;
 static volatile int pressure = 0;
 static WaitQueue kswapd_done;
 
+// 碎片指数(千分比)超过KSWAPD_COMPACT_INDEX时，kswapd规整出KSWAPD_COMPACT_ORDER阶的连续块
+#define KSWAPD_COMPACT_ORDER    3
+#define KSWAPD_COMPACT_INDEX    500
+
 static void swap_list_init(swap_list_t *list) {
     list_init(&(list->swap_link));
     list->nr_pages = 0;
@@ -212,8 +218,8 @@ static void swap_free_page(struct Page *page) {
     // 疑问：hash_list的作用是什么？
     // 答：用于根据swap的entry索引号快速查找到映射的page
     swap_page_del(page);
-    // 该页没有任何用处了，将其归还给buddy system
-    free_page(page);
+    // 该页没有任何用处了，将其归还给buddy system，它的内容很久没有被访问过，作为cold page释放
+    free_cold_page(page);
 }
 
 // 根据entry，从hash list中找到对应的page
@@ -392,6 +398,11 @@ failed_unlock:
     return ret;
 }
 
+// 只在swap的hash_list中查找entry对应的page，不会读swap分区
+struct Page *swap_cache_lookup(swap_entry_t entry) {
+    return swap_hash_find(entry);
+}
+
 // 将一个swap out page的内容复制到一个新的page中
 // 这个新的page需要设置PG_swap标志，并且加入到swap active list
 int swap_copy_entry(swap_entry_t entry, swap_entry_t *store) {
@@ -536,6 +547,10 @@ static int swap_out_vma(MmStruct *mm, VmaStruct *vma, uintptr_t addr, size_t req
         // addr 不在vma的地址范围，不能释放这个vma的page
         return 0;
     }
+    if (vma->vm_flags & VM_VDSO) {
+        // vdso页由用户态直接读取，不能换出
+        return 0;
+    }
     uintptr_t end;
     size_t free_count = 0;
     addr = ROUNDDOWN(addr, PAGE_SIZE);
@@ -547,8 +562,25 @@ static int swap_out_vma(MmStruct *mm, VmaStruct *vma, uintptr_t addr, size_t req
             addr = ROUNDDOWN(addr + PAGE_SIZE, PAGE_SIZE);
             continue;
         }
+        if (page_table_shared(mm->page_dir[PDX(addr)])) {
+            // 共享的页表被修改时，其他mm的tlb不会被刷新，等到复制之后再换出
+            addr = ROUNDDOWN(addr + PT_SIZE, PT_SIZE);
+            continue;
+        }
+        if (*ptep & PTE_PS) {
+            // 大页先拆成4K的页表，再逐页换出
+            if (split_huge_pde(mm->page_dir, addr) != 0) {
+                addr = ROUNDDOWN(addr + PT_SIZE, PT_SIZE);
+                continue;
+            }
+            ptep = get_pte(mm->page_dir, addr, 0);
+        }
         if (*ptep & PTE_P) {
             struct Page *page = pte2page(*ptep);
+            if (page == zero_page) {
+                // 零页常驻内存，换出没有意义
+                goto try_next_entry;
+            }
             // 用户态地址申请的页都不是保留页
             // 内核态地址映射的页都是保留页
             assert(!PageReserved(page));
@@ -656,9 +688,240 @@ static int swap_out_mm(MmStruct *mm, size_t require) {
     return free_count;
 }
 
+// 内存规整(compaction)：空闲page很多但没有足够大的连续块时，选出一个迁移代价最小的order阶伙伴块，
+// 先把块中用户page的pte都替换成swap entry(与swap_out_vma相同)，使page只留在swap的hash_list中，
+// 再把这些page的内容复制到块外的新page上并替换hash_list中的page，之后缺页时由swap_in_page和page_insert重新映射。
+// 块中剩下的page都释放之后就在伙伴系统中合并成了一个完整的块
+
+// 对mm中所有可换出的vma的每个pte调用func
+static void compact_walk_mm(MmStruct *mm, void (*func)(MmStruct *mm, VmaStruct *vma, uintptr_t addr, pte_t *ptep, void *arg), void *arg) {
+    ListEntry *head = &(mm->mmap_link), *le = head;
+    while ((le = list_next(le)) != head) {
+        VmaStruct *vma = le2vma(le, vma_link);
+        // 共享内存的page还被shmem引用着，vdso页被所有进程共享，都不能迁移
+        if (vma->vm_flags & (VM_SHARE | VM_VDSO)) {
+            continue;
+        }
+        uintptr_t addr = ROUNDDOWN(vma->vm_start, PAGE_SIZE), end = ROUNDUP(vma->vm_end, PAGE_SIZE);
+        while (addr < end) {
+            pte_t *ptep = get_pte(mm->page_dir, addr, 0);
+            // 大页本身就是一个完整的最高阶伙伴块，不需要迁移；共享的页表与换出时一样跳过
+            if (ptep == NULL || (*ptep & PTE_PS) || page_table_shared(mm->page_dir[PDX(addr)])) {
+                addr = ROUNDDOWN(addr + PT_SIZE, PT_SIZE);
+                continue;
+            }
+            if (*ptep & PTE_P) {
+                func(mm, vma, addr, ptep, arg);
+            }
+            addr += PAGE_SIZE;
+        }
+    }
+}
+
+static void compact_walk(void (*func)(MmStruct *mm, VmaStruct *vma, uintptr_t addr, pte_t *ptep, void *arg), void *arg) {
+    ListEntry *head = &process_mm_list, *le = head;
+    while ((le = list_next(le)) != head) {
+        compact_walk_mm(le2mm(le, process_mm_link), func, arg);
+    }
+}
+
+static void compact_mark_movable(MmStruct *mm, VmaStruct *vma, uintptr_t addr, pte_t *ptep, void *arg) {
+    struct Page *page = pte2page(*ptep);
+    if (!PageReserved(page)) {
+        SetPageMovable(page);
+    }
+}
+
+typedef struct {
+    struct Page *base;
+    size_t n;
+} compact_range_t;
+
+// 把映射到range中page的pte替换成swap entry
+static void compact_unmap(MmStruct *mm, VmaStruct *vma, uintptr_t addr, pte_t *ptep, void *arg) {
+    compact_range_t *range = arg;
+    struct Page *page = pte2page(*ptep);
+    if (!(page >= range->base && page < range->base + range->n)) {
+        return;
+    }
+    if (!PageSwap(page)) {
+        if (!swap_page_add(page, 0)) {
+            return;
+        }
+        swap_active_list_add(page);
+    } else if (*ptep & PTE_D) {
+        SetPageDirty(page);
+    }
+    swap_duplicate(page->index);
+    page_ref_dec(page);
+    *ptep = page->index;
+    tlb_invalidate(mm->page_dir, addr);
+}
+
+// 迁移base开始的order阶块需要移动的page数，块中有不能迁移的page时返回-1
+static int compact_block_cost(struct Page *base, size_t order) {
+    size_t i = 0, n = (1 << order);
+    int cost = 0;
+    while (i < n) {
+        struct Page *page = base + i;
+        if (PageProperty(page)) {
+            // 伙伴系统中的空闲块
+            i += (1 << page->property);
+            continue;
+        }
+        if (PageReserved(page) || PageSlab(page)) {
+            return -1;
+        }
+        if (!PageMovable(page) && !(PageSwap(page) && page_ref(page) == 0)) {
+            return -1;
+        }
+        cost++;
+        i++;
+    }
+    return cost;
+}
+
+// 把只留在swap hash_list中的page迁移到一个新的page上
+static bool compact_migrate_page(struct Page *page, compact_range_t *range, ListEntry *held) {
+    struct Page *new_page;
+    while (1) {
+        if ((new_page = alloc_page()) == NULL) {
+            return false;
+        }
+        if (!(new_page >= range->base && new_page < range->base + range->n)) {
+            break;
+        }
+        // 申请到的是块内的空闲page，先留着，规整结束后再释放
+        list_add(held, &(new_page->page_link));
+    }
+    memcpy(page2kva(new_page), page2kva(page), PAGE_SIZE);
+    swap_entry_t entry = page->index;
+    bool active = PageActive(page), dirty = PageDirty(page);
+    swap_list_del(page);
+    swap_page_del(page);
+    ClearPageDirty(page);
+    ClearPageActive(page);
+
+    swap_page_add(new_page, entry);
+    if (dirty) {
+        SetPageDirty(new_page);
+    }
+    if (active) {
+        swap_active_list_add(new_page);
+    } else {
+        swap_inactive_list_add(new_page);
+    }
+    free_page(page);
+    return true;
+}
+
+// 规整失败后推迟之后的规整(与linux的compaction_deferred相同)：每个order连续失败一次，
+// 就多跳过一倍的规整请求，最多跳过1 << COMPACT_MAX_DEFER_SHIFT次，成功后清零
+#define COMPACT_MAX_ORDER           10
+#define COMPACT_MAX_DEFER_SHIFT     6
+
+static unsigned int compact_considered[COMPACT_MAX_ORDER + 1];
+static unsigned int compact_defer_shift[COMPACT_MAX_ORDER + 1];
+
+static bool compact_deferred(size_t order) {
+    if (++compact_considered[order] >= (1 << compact_defer_shift[order])) {
+        compact_considered[order] = 0;
+        return false;
+    }
+    return true;
+}
+
+static void compact_defer(size_t order, bool success) {
+    compact_considered[order] = 0;
+    if (success) {
+        compact_defer_shift[order] = 0;
+    } else if (compact_defer_shift[order] < COMPACT_MAX_DEFER_SHIFT) {
+        compact_defer_shift[order]++;
+    }
+}
+
+// 选出并迁移一个order阶的块，由compact_memory在没有被推迟时调用
+static bool __compact_memory(size_t order) {
+    size_t n = (1 << order);
+    pcp_drain();
+
+    // 标记所有被用户页表映射的page，然后找出迁移代价最小的块
+    compact_walk(compact_mark_movable, NULL);
+    struct Page *pages = get_pages_base(), *best = NULL, *page;
+    size_t npage = get_npage();
+    int cost, best_cost = -1;
+    for (page = pages; page + n <= pages + npage; page++) {
+        if (!buddy_block_aligned(page, order)) {
+            continue;
+        }
+        if ((cost = compact_block_cost(page, order)) >= 0 && (best == NULL || cost < best_cost)) {
+            best = page, best_cost = cost;
+            if (cost == 0) {
+                break;
+            }
+        }
+        page += n - 1;
+    }
+    for (page = pages; page < pages + npage; page++) {
+        ClearPageMovable(page);
+    }
+    if (best == NULL) {
+        return false;
+    }
+
+    compact_range_t range = {best, n};
+    compact_walk(compact_unmap, &range);
+
+    ListEntry held;
+    list_init(&held);
+    size_t i = 0;
+    while (i < n) {
+        page = best + i;
+        if (PageProperty(page)) {
+            i += (1 << page->property);
+            continue;
+        }
+        if (PageSwap(page) && page_ref(page) == 0) {
+            if (!compact_migrate_page(page, &range, &held)) {
+                break;
+            }
+        }
+        i++;
+    }
+    while (!list_empty(&held)) {
+        page = le2page(list_next(&held), page_link);
+        list_del(&(page->page_link));
+        free_page(page);
+    }
+    // 迁移走的page都在pcp链表中，归还给伙伴系统之后才能合并
+    pcp_drain();
+    return buddy_fragmentation_index(order) < 0;
+}
+
+// 规整出一个order阶的连续空闲块，成功返回true
+bool compact_memory(size_t order) {
+    if (!swap_init_ok || order == 0 || order > COMPACT_MAX_ORDER || current == NULL) {
+        return false;
+    }
+    // 迁移时需要申请新的page，空闲page太少时规整没有意义
+    if (nr_free_pages() < 2 * (1 << order)) {
+        return false;
+    }
+    if (compact_deferred(order)) {
+        return false;
+    }
+    bool success = __compact_memory(order);
+    compact_defer(order, success);
+    return success;
+}
+
 int kswapd_main(void *arg) {
     int guard = 0;
     while (1) {
+        if (pressure > 0) {
+            // 先回收slab和inode等缓存，它们的回收代价比换出page小
+            pressure -= (int)shrink_caches(pressure);
+        }
         if (pressure > 0) {
             // todo: 为什么needs的值是（pressure << 5）
             int needs = (pressure << 5), rounds = 16;
@@ -686,11 +949,16 @@ int kswapd_main(void *arg) {
         pressure = 0;
         guard = 0;
         kswapd_wakeup_all();
+        // 空闲page足够但主要是碎片时，提前规整出kernel stack等需要的连续块
+        if (buddy_fragmentation_index(KSWAPD_COMPACT_ORDER) >= KSWAPD_COMPACT_INDEX) {
+            compact_memory(KSWAPD_COMPACT_ORDER);
+        }
         do_sleep(1000);
     }
 }
 
 void check_swap(void) {
+    slab_drain();
     size_t nr_free_pages_store = nr_free_pages();
     size_t slab_allocated_store = slab_allocated();
 
@@ -1107,6 +1375,7 @@ void check_swap(void) {
         mem_map[offset] = SWAP_UNUSED;
     }
 
+    slab_drain();
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
 
@@ -1114,6 +1383,7 @@ void check_swap(void) {
 }
 
 static void check_mm_swap(void) {
+    slab_drain();
     size_t nr_free_pages_store = nr_free_pages();
     size_t slab_allocated_store = slab_allocated();
 
@@ -1178,6 +1448,7 @@ static void check_mm_swap(void) {
 
     mm_destory(mm0);
 
+    slab_drain();
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
 
@@ -1416,6 +1687,7 @@ static void check_mm_swap(void) {
     for (i = 0; i < max_swap_offset; i++) {
         assert(mem_map[i] == SWAP_UNUSED);
     }
+    slab_drain();
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
 
@@ -1423,6 +1695,7 @@ static void check_mm_swap(void) {
 }
 
 static void check_mm_shmem_swap(void) {
+    slab_drain();
     size_t nr_free_pages_store = nr_free_pages();
     size_t slab_allocated_store = slab_allocated();
 
@@ -1597,6 +1870,7 @@ static void check_mm_shmem_swap(void) {
         assert(mem_map[i] == SWAP_UNUSED);
     }
     
+    slab_drain();
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
 
@@ -35,7 +35,9 @@ int swap_page_count(struct Page *page);
 void swap_decrease(swap_entry_t entry);
 void swap_duplicate(swap_entry_t entry);
 int swap_in_page(swap_entry_t entry, struct Page **pagep);
+struct Page *swap_cache_lookup(swap_entry_t entry);
 int swap_copy_entry(swap_entry_t entry, swap_entry_t *store);
+bool compact_memory(size_t order);
 
 int kswapd_main(void *arg) __attribute__((noreturn));
 #endif // __KERNEL_MM_SWAP_H__
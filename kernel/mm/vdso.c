@@ -0,0 +1,40 @@
+#include <vdso.h>
+#include <error.h>
+#include <pmm.h>
+#include <mmu.h>
+#include <memlayout.h>
+#include <string.h>
+#include <clock.h>
+#include <assert.h>
+
+// 在mm中映射vdso页并填入时钟数据，pid由vdso_set_pid在进程确定后填入
+// vdso页对每个mm都是私有的，fork时不复制(见dup_mmap)，而是重新映射一个
+int vdso_map(MmStruct *mm) {
+    // 用户库按VDSO_BASE读取vdso页，必须和内核映射的地址一致
+    static_assert(VDSO_BASE == USER_VDSO);
+    int ret;
+    if ((ret = mm_map(mm, USER_VDSO, PAGE_SIZE, VM_READ | VM_VDSO, NULL)) != 0) {
+        return ret;
+    }
+    // 用户态只读
+    struct Page *page = page_dir_alloc_page(mm->page_dir, USER_VDSO, PTE_U);
+    if (page == NULL) {
+        return -E_NO_MEM;
+    }
+    VdsoData *data = page2kva(page);
+    memset(data, 0, PAGE_SIZE);
+    data->tsc_base = tsc_base;
+    data->tsc_mult = tsc_mult;
+    return 0;
+}
+
+void vdso_set_pid(MmStruct *mm, int pid) {
+    if (mm == NULL) {
+        return;
+    }
+    pte_t *ptep = get_pte(mm->page_dir, USER_VDSO, 0);
+    if (ptep != NULL && (*ptep & PTE_P)) {
+        VdsoData *data = page2kva(pte2page(*ptep));
+        data->pid = pid;
+    }
+}
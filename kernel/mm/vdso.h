@@ -0,0 +1,10 @@
+#ifndef __KERNEL_MM_VDSO_H__
+#define __KERNEL_MM_VDSO_H__
+
+#include <vmm.h>
+#include <vdso_data.h>
+
+int vdso_map(MmStruct *mm);
+void vdso_set_pid(MmStruct *mm, int pid);
+
+#endif // __KERNEL_MM_VDSO_H__
@@ -9,6 +9,8 @@
 #include <string.h>
 #include <process.h>
 #include <stdio.h>
+#include <inode.h>
+#include <iobuf.h>
 
 static int vma_compare(rbtree_node_t *node1, rbtree_node_t *node2) {
     VmaStruct *vma1 = rbn2vma(node1, rb_link);
@@ -18,8 +20,14 @@ static int vma_compare(rbtree_node_t *node1, rbtree_node_t *node2) {
     return (start1 < start2) ? -1 : ((start1 > start2) ? 1 : 0);
 }
 
+static kmem_cache_t *mm_cachep = NULL;
+static kmem_cache_t *vma_cachep = NULL;
+
+// 自检时使用的mm，见check_page_fault
+extern MmStruct *check_mm_struct;
+
 MmStruct *mm_create(void) {
-    MmStruct *mm = kmalloc(sizeof(MmStruct));
+    MmStruct *mm = kmem_cache_alloc(mm_cachep);
     if (mm != NULL) {
         list_init(&(mm->mmap_link));
         mm->mmap_cache = NULL;
@@ -38,17 +46,40 @@ MmStruct *mm_create(void) {
 }
 
 VmaStruct *vma_create(uintptr_t vm_start, uintptr_t vm_end, uint32_t vm_flags) {
-    VmaStruct *vma = kmalloc(sizeof(VmaStruct));
+    VmaStruct *vma = kmem_cache_alloc(vma_cachep);
     if (vma != NULL) {
         vma->vm_start = vm_start;
         vma->vm_end = vm_end;
         vma->vm_flags = vm_flags;
         // rbtree_node_init(&(vma->rb_link), rbtree_sentinel(tree));
         list_init(&(vma->vma_link));
+        vma->vm_file = NULL;
+        vma->vm_image = NULL;
     }
     return vma;
 }
 
+// 记录vma按需加载的程序映像，file不为NULL时vma持有file的一个引用
+void vma_set_image(VmaStruct *vma, struct inode *file, const unsigned char *image,
+        off_t off, uintptr_t va, size_t size) {
+    assert(vma->vm_flags & VM_IMAGE);
+    if (file != NULL) {
+        vop_ref_inc(file);
+    }
+    vma->vm_file = file;
+    vma->vm_image = image;
+    vma->vm_file_off = off;
+    vma->vm_file_va = va;
+    vma->vm_file_size = size;
+}
+
+static inline void vma_copy_image(VmaStruct *to, VmaStruct *from) {
+    if (from->vm_flags & VM_IMAGE) {
+        vma_set_image(to, from->vm_file, from->vm_image,
+            from->vm_file_off, from->vm_file_va, from->vm_file_size);
+    }
+}
+
 // 找到addr右邊最近的vma
 static inline VmaStruct *find_vma_rb(rbtree_t *tree, uintptr_t addr) {
     rbtree_node_t *node = rbtree_root(tree);
@@ -235,7 +266,10 @@ static void vma_destory(VmaStruct *vma) {
             shmem_destory(vma->shmem);
         }
     }
-    kfree(vma);
+    if (vma->vm_file != NULL) {
+        vop_ref_dec(vma->vm_file);
+    }
+    kmem_cache_free(vma_cachep, vma);
 }
 
 void mm_destory(MmStruct *mm) {
@@ -247,14 +281,28 @@ void mm_destory(MmStruct *mm) {
         list_del(entry);
         vma_destory(le2vma(entry, vma_link));
     }
-    kfree(mm);
+    kmem_cache_free(mm_cachep, mm);
 }
 
 static void check_vmm(void);
 static void check_vma_struct();
 static void check_page_fault();
 
+// 全局的零页：私有匿名内存第一次被读时只读地映射零页，写入时再通过写时复制得到自己的page。
+// 零页一直由内核持有一个引用并标记为保留页，不会被释放、换出或者迁移
+struct Page *zero_page;
+
 void vmm_init(void) {
+    if ((mm_cachep = kmem_cache_create("mm_struct", sizeof(MmStruct), 0, NULL)) == NULL ||
+        (vma_cachep = kmem_cache_create("vma_struct", sizeof(VmaStruct), 0, NULL)) == NULL) {
+        panic("vmm_init: create slab cache failed.\n");
+    }
+    if ((zero_page = alloc_page()) == NULL) {
+        panic("vmm_init: alloc zero page failed.\n");
+    }
+    memset(page2kva(zero_page), 0, PAGE_SIZE);
+    set_page_ref(zero_page, 1);
+    SetPageReserved(zero_page);
     check_vmm();
 }
 
@@ -395,11 +443,33 @@ static void unmap_range(pte_t *page_dir, uintptr_t start, uintptr_t end) {
     assert(USER_ACCESS(start, end));
 
     do {
+        pde_t *pdep = &page_dir[PDX(start)];
+        if (page_table_shared(*pdep)) {
+            if (start % PT_SIZE == 0 && start + PT_SIZE <= end) {
+                // 其他mm还在使用这个页表，只放弃自己的引用
+                page_ref_dec(pde2page(*pdep));
+                *pdep = 0;
+                tlb_invalidate_all(page_dir);
+                start += PT_SIZE;
+                continue;
+            }
+            // 只解除页表中的一部分映射，先复制出自己的页表。
+            // mm_unmap在每个vma的边界上都已经复制过了，这里不会再分配内存
+            int ret = unshare_page_table(page_dir, start);
+            assert(ret == 0);
+        }
         pte_t *ptep = get_pte(page_dir, start, 0);
         if (ptep == NULL) {
             start = ROUNDDOWN(start + PT_SIZE, PT_SIZE);
             continue;
         }
+        if (*ptep & PTE_PS) {
+            // 部分解除映射的大页在mm_unmap中已经被拆分了
+            assert(start % PT_SIZE == 0 && start + PT_SIZE <= end);
+            remove_huge_pde(page_dir, start);
+            start += PT_SIZE;
+            continue;
+        }
         if (*ptep != 0) {
             page_remove_pte(page_dir, start, ptep);
         }
@@ -407,6 +477,18 @@ static void unmap_range(pte_t *page_dir, uintptr_t start, uintptr_t end) {
     } while (start != 0 && start < end);
 }
 
+// addr落在大页或者共享页表的中间时，将大页拆成4K的页表、复制出自己的页表，
+// 这样大页和共享的页表只会被整个解除映射
+static int unmap_boundary(pde_t *page_dir, uintptr_t addr) {
+    if (addr % PT_SIZE == 0) {
+        return 0;
+    }
+    if (page_dir[PDX(addr)] & PTE_PS) {
+        return split_huge_pde(page_dir, addr);
+    }
+    return unshare_page_table(page_dir, addr);
+}
+
 int mm_unmap(MmStruct *mm, uintptr_t addr, size_t len) {
     uintptr_t start = ROUNDDOWN(addr, PAGE_SIZE);
     uintptr_t end = ROUNDUP(addr + len, PAGE_SIZE);
@@ -420,12 +502,29 @@ int mm_unmap(MmStruct *mm, uintptr_t addr, size_t len) {
         // 没有找到addr对应的vma
         return 0;
     }
+    if (mm->page_dir != NULL) {
+        // 一个页表中可能有多个vma，unmap_range是按vma的范围解除映射的，
+        // 所以在修改vma之前就要在每个要解除映射的vma的边界上拆分大页、复制共享的页表
+        VmaStruct *iter = vma;
+        while (iter->vm_start < end) {
+            if (unmap_boundary(mm->page_dir, MAX(iter->vm_start, start)) != 0 ||
+                unmap_boundary(mm->page_dir, MIN(iter->vm_end, end)) != 0) {
+                return -E_NO_MEM;
+            }
+            ListEntry *next = list_next(&(iter->vma_link));
+            if (next == &(mm->mmap_link)) {
+                break;
+            }
+            iter = le2vma(next, vma_link);
+        }
+    }
     // 如果[start, end)在vma的地址范围内，则将vma分成左边界和右边界两个vma
     if (vma->vm_start < start && end < vma->vm_end) {
         VmaStruct *left_vma;
         if ((left_vma = vma_create(vma->vm_start, start, vma->vm_flags)) == NULL) {
             return -E_NO_MEM;
         }
+        vma_copy_image(left_vma, vma);
         // 解除[start, end)的映射，将vma拆成了[vma->start, start)和[end, vma->end)
         // 将vma范围缩小为[end, vma->vm_end)
         vma_resize(vma, end, vma->vm_end);
@@ -483,6 +582,7 @@ void exit_range(pde_t *page_dir, uintptr_t start, uintptr_t end) {
     start = ROUNDDOWN(start, PT_SIZE);
     do {
         int pde_idx = PDX(start);
+        assert(!(page_dir[pde_idx] & PTE_PS));
         if (page_dir[pde_idx] & PTE_P) {
             free_page(pde2page(page_dir[pde_idx]));
             page_dir[pde_idx] = 0;
@@ -506,6 +606,8 @@ int copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end, bool shar
             start = ROUNDDOWN(start + PT_SIZE, PT_SIZE);
             continue;
         }
+        // 大页和共享的页表由copy_page_tables整个处理
+        assert(!(*ptep & PTE_PS) && !page_table_shared(from[PDX(start)]));
         if (*ptep != 0) {
             if ((new_ptep = get_pte(to, start, 1)) == NULL) {
                 return -E_NO_MEM;
@@ -537,6 +639,69 @@ int copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end, bool shar
     return 0;
 }
 
+// [la, la + PT_SIZE)中是否只有私有的vma，这样的页表可以整个共享给子进程
+static bool page_table_private(MmStruct *mm, uintptr_t la) {
+    VmaStruct *vma = find_vma(mm, la);
+    while (vma != NULL && vma->vm_start < la + PT_SIZE) {
+        if (vma->vm_flags & (VM_SHARE | VM_VDSO)) {
+            return false;
+        }
+        ListEntry *entry = list_next(&(vma->vma_link));
+        vma = (entry == &(mm->mmap_link)) ? NULL : le2vma(entry, vma_link);
+    }
+    return true;
+}
+
+// fork时按4M复制from的页表：大页和只包含私有vma的页表都直接只读地共享给to，
+// 复制的开销与父进程使用的内存大小无关。大页在写入时拆分，页表在需要修改时由unshare_page_table复制。
+// 包含共享内存或者vdso的页表仍然逐个pte复制
+static int copy_page_tables(MmStruct *to, MmStruct *from) {
+    bool flush = false;
+    uintptr_t la;
+    for (la = ROUNDDOWN(USER_BASE, PT_SIZE); la < USER_TOP; la += PT_SIZE) {
+        pde_t *pdep = &(from->page_dir[PDX(la)]);
+        if (!(*pdep & PTE_P)) {
+            continue;
+        }
+        if (*pdep & PTE_PS) {
+            // 大页中的每个page都单独计数
+            struct Page *page = pde2page(*pdep);
+            int i;
+            for (i = 0; i < PTE_ENTRIES; i++) {
+                page_ref_inc(page + i);
+            }
+        } else if (from != check_mm_struct && page_table_private(from, la)) {
+            // 自检使用的mm按页表项检查复制的结果，不共享页表
+            page_ref_inc(pde2page(*pdep));
+        } else {
+            if (unshare_page_table(from->page_dir, la) != 0) {
+                return -E_NO_MEM;
+            }
+            VmaStruct *vma = find_vma(from, la);
+            while (vma != NULL && vma->vm_start < la + PT_SIZE) {
+                if (!(vma->vm_flags & VM_VDSO)) {
+                    uintptr_t start = MAX(vma->vm_start, la), end = MIN(vma->vm_end, la + PT_SIZE);
+                    if (copy_range(to->page_dir, from->page_dir, start, end, vma->vm_flags & VM_SHARE) != 0) {
+                        return -E_NO_MEM;
+                    }
+                }
+                ListEntry *entry = list_next(&(vma->vma_link));
+                vma = (entry == &(from->mmap_link)) ? NULL : le2vma(entry, vma_link);
+            }
+            continue;
+        }
+        if (*pdep & PTE_W) {
+            *pdep &= ~PTE_W;
+            flush = true;
+        }
+        to->page_dir[PDX(la)] = *pdep;
+    }
+    if (flush) {
+        tlb_invalidate_all(from->page_dir);
+    }
+    return 0;
+}
+
 int dup_mmap(MmStruct *to, MmStruct *from) {
     assert(to != NULL && from != NULL);
     ListEntry *head = &(from->mmap_link);
@@ -544,6 +709,10 @@ int dup_mmap(MmStruct *to, MmStruct *from) {
     while ((entry = list_prev(entry)) != head) {
         VmaStruct *vma = NULL, *new_vma = NULL;
         vma = le2vma(entry, vma_link);
+        if (vma->vm_flags & VM_VDSO) {
+            // vdso页是每个mm私有的，由copy_mm重新映射
+            continue;
+        }
         new_vma = vma_create(vma->vm_start, vma->vm_end, vma->vm_flags);
         if (new_vma == NULL) {
             return -E_NO_MEM;
@@ -553,21 +722,25 @@ int dup_mmap(MmStruct *to, MmStruct *from) {
                 new_vma->shmem_off = vma->shmem_off;
                 shmem_ref_inc(vma->shmem);
             }
+            vma_copy_image(new_vma, vma);
         }
         insert_vma_struct(to, new_vma);
-        bool share = (vma->vm_flags & VM_SHARE);
-        // 复制页表项
-        if (copy_range(to->page_dir, from->page_dir, vma->vm_start, vma->vm_end, share) != 0) {
-            return -E_NO_MEM;
-        }
     }
-    return 0;
+    return copy_page_tables(to, from);
 }
 
 // 删除vma映射的物理页，以及所有页表，只留下一个页目录
 void exit_mmap(MmStruct *mm) {
     assert(mm != NULL && mm_count(mm) == 0);
     pde_t *page_dir = mm->page_dir;
+    uintptr_t la;
+    // 先放弃还和其他mm共享的页表，一个页表可能跨了几个vma
+    for (la = ROUNDDOWN(USER_BASE, PT_SIZE); la < USER_TOP; la += PT_SIZE) {
+        if (page_table_shared(page_dir[PDX(la)])) {
+            page_ref_dec(pde2page(page_dir[PDX(la)]));
+            page_dir[PDX(la)] = 0;
+        }
+    }
     ListEntry *head = &(mm->mmap_link);
     ListEntry *entry = head;
     while ((entry = list_next(entry)) != head) {
@@ -581,11 +754,13 @@ void exit_mmap(MmStruct *mm) {
 }
 
 static void check_vmm(void) {
+    slab_drain();
     size_t nr_free_pages_store = nr_free_pages();
     size_t slab_allocated_store = slab_allocated();
 
     check_vma_struct();
     check_page_fault();
+    slab_drain();
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
 
@@ -594,6 +769,7 @@ static void check_vmm(void) {
 
 
 static void check_vma_struct() {
+    slab_drain();
     size_t nr_free_pages_store = nr_free_pages();
     size_t slab_allocated_store = slab_allocated();
 
@@ -634,6 +810,7 @@ static void check_vma_struct() {
         assert(vma->vm_start == j * 5 && vma->vm_end == j * 5 + 2);
     }
     mm_destory(mm);
+    slab_drain();
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
     printk("check_vma_struct: successed\n");
@@ -642,6 +819,7 @@ static void check_vma_struct() {
 MmStruct *check_mm_struct;
 
 static void check_page_fault() {
+    slab_drain();
     size_t nr_free_pages_store = nr_free_pages();
     size_t slab_allocated_store = slab_allocated();
 
@@ -679,10 +857,149 @@ static void check_page_fault() {
     mm_destory(mm);
     check_mm_struct = NULL;
 
+    slab_drain();
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
 }
 
+// 透明大页：缺页地址所在的4M区域完全落在一个私有的匿名vma中，并且还没有页表时，
+// 用一个order为10的伙伴块和一个PTE_PS的页目录项映射整个区域，减少缺页和tlb miss的次数。
+// 申请不到连续的4M时退回4K的映射
+static bool thp_fault(MmStruct *mm, VmaStruct *vma, uintptr_t addr, uint32_t perm) {
+    uintptr_t start = ROUNDDOWN(addr, PT_SIZE);
+    if (vma->vm_flags & (VM_SHARE | VM_STACK | VM_VDSO | VM_IMAGE)) {
+        return false;
+    }
+    // 自检使用的mm按4K页精确统计申请的page数
+    if (mm == check_mm_struct) {
+        return false;
+    }
+    if (start < vma->vm_start || start + PT_SIZE > vma->vm_end || !USER_ACCESS(start, start + PT_SIZE)) {
+        return false;
+    }
+    struct Page *page;
+    if ((page = try_alloc_pages(PTE_ENTRIES)) == NULL) {
+        return false;
+    }
+    int i;
+    for (i = 0; i < PTE_ENTRIES; i++) {
+        set_page_ref(page + i, 1);
+    }
+    memset(page2kva(page), 0, PT_SIZE);
+    mm->page_dir[PDX(start)] = page2pa(page) | PTE_P | PTE_PS | perm;
+    tlb_invalidate(mm->page_dir, start);
+    return true;
+}
+
+// 从程序映像中读入addr所在page的内容，不属于映像的部分填0
+static int vma_fill_page(VmaStruct *vma, uintptr_t addr, struct Page *page) {
+    void *kva = page2kva(page);
+    uintptr_t start = MAX(addr, vma->vm_file_va);
+    uintptr_t end = MIN(addr + PAGE_SIZE, vma->vm_file_va + vma->vm_file_size);
+    memset(kva, 0, PAGE_SIZE);
+    if (start >= end) {
+        return 0;
+    }
+    off_t off = vma->vm_file_off + (start - vma->vm_file_va);
+    if (vma->vm_file == NULL) {
+        memcpy(kva + (start - addr), vma->vm_image + off, end - start);
+        return 0;
+    }
+    int ret;
+    IOBuf __iob, *iob = iobuf_init(&__iob, kva + (start - addr), end - start, off);
+    if ((ret = vop_read(vma->vm_file, iob)) != 0) {
+        return ret;
+    }
+    return (iobuf_used(iob) == end - start) ? 0 : -E_INVAL_ELF;
+}
+
+// vma中addr所在的page是否全部为0：匿名内存，或者程序映像中不属于文件内容的部分(bss)
+static bool vma_zero_fill(VmaStruct *vma, uintptr_t addr) {
+    if (vma->vm_flags & VM_VDSO) {
+        return false;
+    }
+    if (vma->vm_flags & VM_IMAGE) {
+        return addr + PAGE_SIZE <= vma->vm_file_va || addr >= vma->vm_file_va + vma->vm_file_size;
+    }
+    return true;
+}
+
+// fault-around：处理完一次缺页之后，顺便把同一个vma、同一个页表中已经在内存里的相邻page也映射上，
+// 包括还在swap缓存中的page、共享内存中的page以及读缺页时的零页，顺序访问时就不必每个page都缺页一次。
+// 程序映像中的page要从文件读入，不在此列
+static int fault_around_pages = FAULT_AROUND_PAGES;
+static size_t nr_page_faults, nr_fault_around;
+
+// 设置fault-around窗口的page数，npages小于0时只查询，返回之前的值
+int set_fault_around(int npages) {
+    int old = fault_around_pages;
+    if (npages >= 0) {
+        fault_around_pages = MIN(npages, FAULT_AROUND_MAX);
+    }
+    return old;
+}
+
+void fault_around_print_info(void) {
+    printk("fault-around window: %d pages, page faults: %d, pages mapped around: %d\n",
+        fault_around_pages, nr_page_faults, nr_fault_around);
+}
+
+// ptep原来不存在映射，tlb中不会有它的缓存，因此不需要像page_insert那样刷新tlb
+static inline void fault_around_map(pte_t *ptep, struct Page *page, uint32_t perm) {
+    page_ref_inc(page);
+    *ptep = page2pa(page) | PTE_P | perm;
+    nr_fault_around++;
+}
+
+static void do_fault_around(MmStruct *mm, VmaStruct *vma, uintptr_t addr, uint32_t perm, bool write) {
+    uintptr_t window = fault_around_pages * PAGE_SIZE;
+    uintptr_t pt_start = ROUNDDOWN(addr, PT_SIZE);
+    uintptr_t start = MAX(ROUNDDOWN(addr, window), MAX(vma->vm_start, pt_start));
+    uintptr_t end = MIN(ROUNDDOWN(addr, window) + window, MIN(vma->vm_end, pt_start + PT_SIZE));
+    bool cow = ((vma->vm_flags & (VM_SHARE | VM_WRITE)) == VM_WRITE);
+    if (vma->vm_flags & VM_STACK) {
+        // 栈底的page用来隔开其他的vma，不能映射
+        start = MAX(start, vma->vm_start + PAGE_SIZE);
+    }
+    uintptr_t va;
+    for (va = start; va < end; va += PAGE_SIZE) {
+        pte_t *ptep = get_pte(mm->page_dir, va, 0);
+        if (va == addr || ptep == NULL || (*ptep & PTE_P)) {
+            continue;
+        }
+        if (*ptep != 0) {
+            // swap entry：page还在swap缓存中时直接映射，与swap_in_page之后的处理相同
+            swap_entry_t entry = *ptep;
+            struct Page *page = swap_cache_lookup(entry);
+            if (page != NULL) {
+                fault_around_map(ptep, page, cow ? (perm & ~PTE_W) : perm);
+                swap_decrease(entry);
+            }
+        } else if (vma->vm_flags & VM_SHARE) {
+            shmem_lock(vma->shmem);
+            pte_t *shmem_ptep = shmem_get_entry(vma->shmem, va - vma->vm_start + vma->shmem_off, 0);
+            if (shmem_ptep != NULL && (*shmem_ptep & PTE_P)) {
+                fault_around_map(ptep, pte2page(*shmem_ptep), perm);
+            }
+            shmem_unlock(vma->shmem);
+        } else if (!write && mm != check_mm_struct && vma_zero_fill(vma, va)) {
+            fault_around_map(ptep, zero_page, perm & ~PTE_W);
+        }
+    }
+}
+
+// 大页中的page是否都只被这一个页目录项引用
+static bool huge_pde_exclusive(pde_t pde) {
+    struct Page *page = pde2page(pde);
+    int i;
+    for (i = 0; i < PTE_ENTRIES; i++) {
+        if (page_ref(page + i) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int do_page_fault(MmStruct *mm, uint32_t error_code, uintptr_t addr) {
     if (mm == NULL) {
         assert(current != NULL);
@@ -700,6 +1017,10 @@ int do_page_fault(MmStruct *mm, uint32_t error_code, uintptr_t addr) {
     }
 
     int ret = -E_INVAL;
+    nr_page_faults++;
+    if (current != NULL) {
+        current->nr_page_faults++;
+    }
 
     VmaStruct *vma = find_vma(mm, addr);
     // 找到的vma可能在addr的右邊
@@ -740,13 +1061,59 @@ int do_page_fault(MmStruct *mm, uint32_t error_code, uintptr_t addr) {
     
     ret = -E_NO_MEM;
 
+    pde_t *pdep = &(mm->page_dir[PDX(addr)]);
+    // fork之后共享的页表在这里第一次需要修改，先复制出自己的页表
+    if (unshare_page_table(mm->page_dir, addr) != 0) {
+        goto failed;
+    }
+    // 读缺页使用零页，只在写入时才申请大页
+    if (*pdep == 0 && (error_code & 2) && thp_fault(mm, vma, addr, perm)) {
+        ret = 0;
+        goto failed;
+    }
+    if (*pdep & PTE_PS) {
+        if (!(error_code & 2) || (*pdep & PTE_W)) {
+            // 同一个mm的另一个线程在这次缺页之后先装好了大页或者恢复了写权限，大页已经允许这次访问
+            ret = 0;
+            goto failed;
+        }
+        // 剩下的只有fork之后对只读大页的写入
+        if (huge_pde_exclusive(*pdep)) {
+            // 另一个mm已经不再引用大页中的page，直接恢复写权限
+            *pdep |= PTE_W;
+            tlb_invalidate(mm->page_dir, addr);
+            ret = 0;
+            goto failed;
+        }
+        if (split_huge_pde(mm->page_dir, addr) != 0) {
+            goto failed;
+        }
+    }
+
     pte_t *ptep = NULL;
     if ((ptep = get_pte(mm->page_dir, addr, 1)) == NULL) {
         goto failed;
     }
 
     if (*ptep == 0) {
-        if (!(vma->vm_flags & VM_SHARE)) {
+        if (!(error_code & 2) && !(vma->vm_flags & VM_SHARE) && mm != check_mm_struct &&
+            vma_zero_fill(vma, addr)) {
+            // 读取还没有写过的匿名page，只读地映射零页(与大页一样，自检使用的mm不使用零页)
+            if (page_insert(mm->page_dir, zero_page, addr, perm & ~PTE_W) != 0) {
+                goto failed;
+            }
+        } else if (vma->vm_flags & VM_IMAGE) {
+            // 程序映像中的page第一次被访问
+            struct Page *page;
+            if ((page = alloc_page()) == NULL) {
+                goto failed;
+            }
+            if ((ret = vma_fill_page(vma, addr, page)) != 0 ||
+                (ret = page_insert(mm->page_dir, page, addr, perm)) != 0) {
+                free_page(page);
+                goto failed;
+            }
+        } else if (!(vma->vm_flags & VM_SHARE)) {
             // vma不是共享内存
             // 如果页表项为0，表示即不存在和page的映射，也不存在和swap的映射
             if (page_dir_alloc_page(mm->page_dir, addr, perm) == 0) {
@@ -866,6 +1233,9 @@ int do_page_fault(MmStruct *mm, uint32_t error_code, uintptr_t addr) {
         }
     }
 
+    if (fault_around_pages > 1 && !(*pdep & PTE_PS)) {
+        do_fault_around(mm, vma, addr, perm, (error_code & 2));
+    }
     ret = 0;
 
 failed:
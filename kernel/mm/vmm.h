@@ -14,6 +14,8 @@ struct mm_struct;
 
 struct shmem_struct;
 
+struct inode;
+
 typedef struct {
     struct mm_struct *vm_mm;
     // [start, end)
@@ -24,6 +26,13 @@ typedef struct {
     ListEntry vma_link;
     struct shmem_struct *shmem;
     size_t shmem_off;
+    // 设置了VM_IMAGE时，[vm_file_va, vm_file_va + vm_file_size)的内容在第一次访问时
+    // 从程序映像中偏移vm_file_off处读入，vma中其余的部分(bss)填0
+    struct inode *vm_file;              // 映像所在的文件，为NULL时映像常驻内核，地址为vm_image
+    const unsigned char *vm_image;
+    off_t vm_file_off;
+    uintptr_t vm_file_va;
+    size_t vm_file_size;
 } VmaStruct;
 
 #define le2vma(le, member)  \
@@ -37,6 +46,8 @@ typedef struct {
 #define VM_EXEC         0x00000004
 #define VM_STACK        0x00000008
 #define VM_SHARE        0x00000010
+#define VM_VDSO         0x00000020
+#define VM_IMAGE        0x00000040
 
 typedef struct mm_struct {
     ListEntry mmap_link;
@@ -68,6 +79,8 @@ VmaStruct *find_vma_intersection(MmStruct *mm, uintptr_t start, uintptr_t end);
 int mm_brk(MmStruct *mm, uintptr_t addr, size_t len);
 MmStruct *mm_create(void);
 void mm_destory(MmStruct *mm);
+void vma_set_image(VmaStruct *vma, struct inode *file, const unsigned char *image,
+        off_t off, uintptr_t va, size_t size);
 int mm_map_shmem(MmStruct *mm, uintptr_t addr, uint32_t vm_flags,
         struct shmem_struct *shmem, VmaStruct **vma_store);
 
@@ -79,9 +92,17 @@ int dup_mmap(MmStruct *to, MmStruct *from);
 
 void exit_mmap(MmStruct *mm);
 
+extern struct Page *zero_page;
+
 void vmm_init(void);
 
+// fault-around窗口的默认大小和上限(page数)，上限为一个页表
+#define FAULT_AROUND_PAGES      16
+#define FAULT_AROUND_MAX        PTE_ENTRIES
+
 int do_page_fault(MmStruct *m, uint32_t error_code, uintptr_t addr);
+int set_fault_around(int npages);
+void fault_around_print_info(void);
 
 bool user_mem_check(MmStruct *mm, uintptr_t start, size_t len, bool write);
 
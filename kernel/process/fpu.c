@@ -0,0 +1,138 @@
+#include <fpu.h>
+#include <x86.h>
+#include <mmu.h>
+#include <process.h>
+#include <slab.h>
+#include <string.h>
+#include <error.h>
+#include <stdio.h>
+#include <cpu.h>
+
+// 延迟保存/恢复fpu状态：
+// 进程切换时设置CR0.TS，进程第一次执行fpu/sse指令时触发#NM(T_DEVICE)，在fpu_trap中恢复它的状态。
+// 只有这次运行中用过fpu的进程(切换时TS已被清除)才在切换出去时保存，从不使用fpu的进程没有任何额外开销。
+// 进程的状态在切换出去时总会保存下来，因此进程可以被迁移到其他cpu；
+// 如果进程回到原来的cpu并且期间没有别的进程在这个cpu上用过fpu，寄存器中仍然是它的状态，不需要恢复。
+
+// cpuid(1).edx
+#define CPUID_FXSR      (1 << 24)
+#define CPUID_SSE       (1 << 25)
+
+// sse控制寄存器的初始值：屏蔽所有异常
+#define MXCSR_DEFAULT   0x1F80
+
+static bool has_fxsr = false;
+static bool has_sse = false;
+
+// fxsave要求状态区16字节对齐
+static kmem_cache_t *fpu_state_cachep = NULL;
+
+static inline void fpu_save(Process *process) {
+    if (has_fxsr) {
+        asm volatile("fxsave (%0)" :: "r" (process->fpu_state) : "memory");
+    } else {
+        // fnsave保存之后会重新初始化fpu，立即恢复，寄存器中仍然保留进程的状态，
+        // 这样fpu_switch之后fpu_owner仍然有效，fpu_copy之后父进程也可以继续使用fpu
+        asm volatile("fnsave (%0); fwait; frstor (%0)" :: "r" (process->fpu_state) : "memory");
+    }
+}
+
+static inline void fpu_restore(Process *process) {
+    if (has_fxsr) {
+        asm volatile("fxrstor (%0)" :: "r" (process->fpu_state));
+    } else {
+        asm volatile("frstor (%0)" :: "r" (process->fpu_state));
+    }
+}
+
+// 每个cpu都要调用一次
+void fpu_init(void) {
+    uint32_t edx;
+    cpuid(1, NULL, NULL, NULL, &edx);
+    has_fxsr = (edx & CPUID_FXSR) != 0;
+    has_sse = has_fxsr && (edx & CPUID_SSE) != 0;
+
+    // bsp第一个调用
+    if (fpu_state_cachep == NULL &&
+        (fpu_state_cachep = kmem_cache_create("fpu_state", FPU_STATE_SIZE, 16, NULL)) == NULL) {
+        panic("fpu_init: create slab cache failed.\n");
+    }
+
+    if (has_fxsr) {
+        uintptr_t cr4 = rcr4() | CR4_OSFXSR;
+        if (has_sse) {
+            cr4 |= CR4_OSXMMEXCPT;
+        }
+        lcr4(cr4);
+    }
+    // 使用原生的fpu错误报告，第一次使用fpu时触发#NM
+    uintptr_t cr0 = rcr0();
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE | CR0_TS;
+    lcr0(cr0);
+    this_cpu()->fpu_owner = NULL;
+}
+
+// 进程切换时调用，TS没有置位说明prev在这次运行中使用了fpu
+void fpu_switch(Process *prev) {
+    uintptr_t cr0 = rcr0();
+    if (!(cr0 & CR0_TS)) {
+        fpu_save(prev);
+        lcr0(cr0 | CR0_TS);
+    }
+}
+
+// #NM：当前进程使用fpu
+int fpu_trap(void) {
+    Cpu *cpu = this_cpu();
+    clts();
+    if (current->fpu_state == NULL) {
+        if ((current->fpu_state = kmem_cache_alloc(fpu_state_cachep)) == NULL) {
+            lcr0(rcr0() | CR0_TS);
+            return -E_NO_MEM;
+        }
+        asm volatile("fninit");
+        if (has_sse) {
+            uint32_t mxcsr = MXCSR_DEFAULT;
+            asm volatile("ldmxcsr %0" :: "m" (mxcsr));
+        }
+    } else if (cpu->fpu_owner != current || current->fpu_cpu != cpu->id) {
+        fpu_restore(current);
+    }
+    cpu->fpu_owner = current;
+    current->fpu_cpu = cpu->id;
+    return 0;
+}
+
+// fork时子进程继承父进程的fpu状态
+int fpu_copy(Process *to, Process *from) {
+    if (from->fpu_state == NULL) {
+        return 0;
+    }
+    if ((to->fpu_state = kmem_cache_alloc(fpu_state_cachep)) == NULL) {
+        return -E_NO_MEM;
+    }
+    if (from == current && !(rcr0() & CR0_TS)) {
+        // 父进程最新的状态还在寄存器中
+        fpu_save(from);
+    }
+    memcpy(to->fpu_state, from->fpu_state, FPU_STATE_SIZE);
+    return 0;
+}
+
+// 进程释放或者执行exec时丢弃fpu状态
+void fpu_release(Process *process) {
+    int i;
+    if (process == current) {
+        lcr0(rcr0() | CR0_TS);
+    }
+    for (i = 0; i < ncpu; i++) {
+        if (cpus[i].fpu_owner == process) {
+            cpus[i].fpu_owner = NULL;
+        }
+    }
+    if (process->fpu_state != NULL) {
+        kmem_cache_free(fpu_state_cachep, process->fpu_state);
+        process->fpu_state = NULL;
+    }
+}
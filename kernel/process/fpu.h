@@ -0,0 +1,17 @@
+#ifndef __KERNEL_PROCESS_FPU_H__
+#define __KERNEL_PROCESS_FPU_H__
+
+#include <types.h>
+
+// fxsave保存的x87/mmx/sse状态的大小，要求16字节对齐
+#define FPU_STATE_SIZE      512
+
+struct process_struct;
+
+void fpu_init(void);
+void fpu_switch(struct process_struct *prev);
+int fpu_trap(void);
+int fpu_copy(struct process_struct *to, struct process_struct *from);
+void fpu_release(struct process_struct *process);
+
+#endif // __KERNEL_PROCESS_FPU_H__
@@ -1,5 +1,6 @@
 #include <process.h>
 #include <slab.h>
+#include <shrinker.h>
 #include <sync.h>
 #include <pmm.h>
 #include <assert.h>
@@ -13,6 +14,16 @@
 #include <elf.h>
 #include <shmem.h>
 #include <vfs.h>
+#include <spinlock.h>
+#include <tick.h>
+#include <time.h>
+#include <clock.h>
+#include <vdso.h>
+#include <fpu.h>
+#include <sysfile.h>
+#include <inode.h>
+#include <iobuf.h>
+#include <stat.h>
 
 // 除了idle_process，其他所有进程都挂接在该链表下面
 ListEntry process_list;
@@ -24,12 +35,8 @@ ListEntry process_mm_list;
 
 static ListEntry hash_list[HASH_LIST_SIZE];
 
-Process *idle_process = NULL;
-
 Process *init_process = NULL;
 
-Process *current = NULL;
-
 Process *kswapd = NULL;
 
 static int nr_process = 0;
@@ -40,11 +47,15 @@ void switch_to(Context *from, Context *to);
 
 
 static void put_page_dir(MmStruct *mm) {
+    page_dir_drop((uintptr_t)mm->page_dir);
     free_page(kva2page(mm->page_dir));
 }
 
+static kmem_cache_t *process_cachep = NULL;
+static kmem_cache_t *kstack_cachep = NULL;
+
 static Process *alloc_process(void) {
-    Process *process = kmalloc(sizeof(Process));
+    Process *process = kmem_cache_alloc(process_cachep);
     if (process != NULL) {
         process->state = STATE_UNINIT;
         process->pid = -1;
@@ -68,6 +79,16 @@ static Process *alloc_process(void) {
         process->time_slice = 0;
         process->sem_queue = NULL;
         process->fs_struct = NULL;
+        process->cpu = -1;
+        process->nice = 0;
+        process->vruntime = 0;
+        process->array = NULL;
+        process->allotment_used = 0;
+        process->boost_epoch = 0;
+        process->fpu_state = NULL;
+        process->fpu_cpu = -1;
+        process->vfork_parent = NULL;
+        process->nr_page_faults = 0;
     }
     return process;
 }
@@ -84,50 +105,47 @@ char *get_process_name(Process *process) {
     return memcpy(name, process->name, PROCESS_NAME_LEN);
 }
 
-// 分配一个没有使用的pid
-// get_pid函数的意图很明显，就是找到一个pid分配给进程。首先变量last_pid，
-// 用于记录上一次分配给进程时的pid值。而分配的过程，一般而言是last_pid+1，
-// 如果超出pid个数的最大值（MAX_PID），那么进程pid值从1开始重新查找未用的。
-// 也就是说，一般用户进程的pid值范围[1，MAX_PID]。
-// 对于变量next_safe的含义是，在[last_pid, next_safe)之间，都是没有使用过
-// 的pid，一旦last_pid+1大于了next_safe，也就是说pid值进入了不可靠空间，
-// 有可能这个值被使用，这时需要遍历process来确认。这样遍历process，找到一个没有
-// 用过的pid，同时，确定next_safe，以保证last_pid到next_safe的区间中pid
-// 是空闲的，这样只要再次分配pid时，其值小于next_safe就可以直接得到，而不
-// 需要遍历process来查找空闲的pid。
-// todo: 这段代码还没有看懂？？？
-static int get_pid(void) {
-    static_assert(MAX_PID > MAX_PROCESS);
-    Process *process = NULL;
-    ListEntry *head = &process_list;
-    ListEntry *entry = NULL;
-    static int next_safe = MAX_PID;
-    static int last_pid = MAX_PID;
-    if (++last_pid >= MAX_PID) {
-        last_pid = 1;
-        goto inside;
-    }
-    if (last_pid >= next_safe) {
-    inside:
-        next_safe = MAX_PID;
-    repeat:
-        entry = head;
-        while ((entry = list_next(entry)) != head) {
-            process = le2process(entry, process_link);
-            if (process->pid == last_pid) {
-                if (++last_pid >= next_safe) {
-                    if (last_pid >= MAX_PID) {
-                        last_pid = 1;
-                    }
-                    next_safe = MAX_PID;
-                    goto repeat;
-                }
-            } else if (process->pid > last_pid && next_safe > process->pid) {
-                next_safe = process->pid;
-            }
+// pid位图，置位表示pid已经被占用，pid 0属于idle进程
+#define PID_BITS_PER_WORD   32
+static uint32_t pid_bitmap[MAX_PID / PID_BITS_PER_WORD];
+// 上一次分配的pid，下一次从它之后开始查找，使得pid循环使用而不是立即重用刚释放的pid
+static int last_pid = 0;
+
+// 在[start, end)范围内按字查找第一个空闲的pid，没有找到时返回-1
+static int find_free_pid(int start, int end) {
+    int pid = start;
+    while (pid < end) {
+        int index = pid / PID_BITS_PER_WORD;
+        // 忽略字中start之前的比特
+        uint32_t free_bits = ~pid_bitmap[index] & (~0U << (pid % PID_BITS_PER_WORD));
+        if (free_bits != 0) {
+            pid = index * PID_BITS_PER_WORD + bsf(free_bits);
+            return pid < end ? pid : -1;
         }
+        pid = (index + 1) * PID_BITS_PER_WORD;
     }
-    return last_pid;
+    return -1;
+}
+
+// 分配一个没有使用的pid，范围为[1, MAX_PID)
+// 从last_pid之后开始按字查找位图，到达MAX_PID后回到1，每次只需要扫描少数几个字
+static int get_pid(void) {
+    static_assert(MAX_PID > MAX_PROCESS);
+    static_assert(MAX_PID % PID_BITS_PER_WORD == 0);
+    int pid;
+    if ((pid = find_free_pid(last_pid + 1, MAX_PID)) < 0) {
+        // 进程数不超过MAX_PROCESS，一定能找到空闲的pid
+        pid = find_free_pid(1, last_pid + 1);
+    }
+    assert(pid > 0);
+    pid_bitmap[pid / PID_BITS_PER_WORD] |= 1U << (pid % PID_BITS_PER_WORD);
+    last_pid = pid;
+    return pid;
+}
+
+static void put_pid(int pid) {
+    assert(0 < pid && pid < MAX_PID);
+    pid_bitmap[pid / PID_BITS_PER_WORD] &= ~(1U << (pid % PID_BITS_PER_WORD));
 }
 
 void process_run(Process *process) {
@@ -139,7 +157,13 @@ void process_run(Process *process) {
         {
             current = process;
             load_esp0(next_process->kstack + K_STACK_SIZE);
-            lcr3(PADDR(next_process->page_dir));
+            // 内核线程不访问用户地址空间，沿用当前加载的页目录；
+            // 同一个mm的线程之间切换页目录不变，都不需要重新加载cr3刷新tlb
+            if (next_process->mm != NULL) {
+                load_page_dir((pde_t *)next_process->page_dir);
+            }
+            // 保存prev使用过的fpu状态，并设置CR0.TS，next使用fpu时再恢复
+            fpu_switch(prev_process);
             switch_to(&(prev_process->context), &(next_process->context));
         }
         local_intr_restore(flag);
@@ -148,6 +172,10 @@ void process_run(Process *process) {
 
 
 static void forkret(void) {
+    // 新进程第一次返回用户态前释放大内核锁，内核线程则继续持有
+    if (!trap_in_kernel(current->tf)) {
+        unlock_kernel();
+    }
     forkrets(current->tf);
 }
 
@@ -187,16 +215,16 @@ int kernel_thread(int (*fn)(void *), void *arg, uint32_t clone_flags) {
 }
 
 static int setup_kstack(Process *process) {
-    struct Page *page = alloc_pages(K_STACK_PAGE);
-    if (page != NULL) {
-        process->kstack = (uintptr_t)page2kva(page);
+    void *kstack = kmem_cache_alloc(kstack_cachep);
+    if (kstack != NULL) {
+        process->kstack = (uintptr_t)kstack;
         return 0;
     }
     return -E_NO_MEM;
 }
 
 static void put_kstack(Process *process) {
-    free_pages(kva2page((void *)process->kstack), K_STACK_PAGE);
+    kmem_cache_free(kstack_cachep, (void *)process->kstack);
 }
 
 static int setup_page_dir(MmStruct *mm) {
@@ -344,7 +372,7 @@ static int copy_mm(uint32_t clone_flags, Process *process) {
     }
     unlock_mm(old_mm);
 
-    if (ret != 0) {
+    if (ret != 0 || (ret = vdso_map(mm)) != 0) {
         goto bad_dup_cleanup_mmap;
     }
 
@@ -413,6 +441,32 @@ static void remove_links(Process *process) {
     nr_process--;
 }
 
+// vfork的父进程等待子进程exec或者退出，在此之前子进程借用父进程的地址空间和用户栈，父进程不能返回用户态
+static void vfork_wait(void) {
+    while (current->flags & PF_VFORK) {
+        current->state = STATE_SLEEPING;
+        current->wait_state = WT_VFORK;
+        schedule();
+        may_killed();
+    }
+    // 子进程已经不再使用这个mm，恢复vdso中的pid
+    if (mm_count(current->mm) == 1) {
+        vdso_set_pid(current->mm, current->pid);
+    }
+}
+
+// vfork的子进程exec或者退出时，地址空间归还给父进程，唤醒父进程
+static void vfork_release(void) {
+    Process *parent = current->vfork_parent;
+    if (parent != NULL) {
+        current->vfork_parent = NULL;
+        parent->flags &= ~PF_VFORK;
+        if (parent->wait_state == WT_VFORK) {
+            wakeup_process(parent);
+        }
+    }
+}
+
 // 父进程创建子进程
 // 1、调用alloc_process分配一个进程结构
 // 2、调用setup_kstack来为新进程分配一个新的子进程内核堆栈
@@ -433,6 +487,7 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, struct TrapFrame *tf) {
 
     process->parent = current;
     assert(current->wait_state == 0);
+    process->nice = current->nice;
 
     assert(current->time_slice >= 0);
     // 当前进程分二分之一的时间片给子进程
@@ -442,9 +497,12 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, struct TrapFrame *tf) {
     if (setup_kstack(process) != 0) {
         goto bad_fork_cleanup_process;
     }
-    if (copy_sem(clone_flags, process) != 0) {
+    if (fpu_copy(process, current) != 0) {
         goto bad_fork_cleanup_kstack;
     }
+    if (copy_sem(clone_flags, process) != 0) {
+        goto bad_fork_cleanup_fpu;
+    }
     if (copy_fs(clone_flags, process) != 0) {
         goto bad_fork_cleanup_sem;
     }
@@ -452,11 +510,17 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, struct TrapFrame *tf) {
         goto bad_fork_cleanup_fs;
     }
     copy_thread(process, stack, tf);
+    if (clone_flags & CLONE_VFORK) {
+        process->vfork_parent = current;
+        current->flags |= PF_VFORK;
+    }
 
     bool flag;
     local_intr_save(flag);
     {
         process->pid = get_pid();
+        // 共享地址空间的线程不能使用vdso中的pid
+        vdso_set_pid(process->mm, (clone_flags & CLONE_VM) ? 0 : process->pid);
         hash_process(process);
         set_links(process);
         // 创建线程
@@ -469,6 +533,9 @@ int do_fork(uint32_t clone_flags, uintptr_t stack, struct TrapFrame *tf) {
     wakeup_process(process);
 
     ret = process->pid;
+    if (clone_flags & CLONE_VFORK) {
+        vfork_wait();
+    }
 
 fork_out:
     return ret;
@@ -476,10 +543,12 @@ bad_fork_cleanup_fs:
     put_fs(process);
 bad_fork_cleanup_sem:
     put_sem_queue(process);
+bad_fork_cleanup_fpu:
+    fpu_release(process);
 bad_fork_cleanup_kstack:
     put_kstack(process);
 bad_fork_cleanup_process:
-    kfree(process);
+    kmem_cache_free(process_cachep, process);
     goto fork_out;
 }
 
@@ -509,7 +578,7 @@ int __do_exit() {
 
     MmStruct *mm = current->mm;
     if (mm != NULL) {
-        lcr3(PADDR(get_boot_page_dir()));
+        load_page_dir(get_boot_page_dir());
         if (mm_count_dec(mm) == 0) {
             // 删除页表和已经映射的page
             exit_mmap(mm);
@@ -524,6 +593,7 @@ int __do_exit() {
         }
         current->mm = NULL;
     }
+    vfork_release();
     // 释放信号量
     put_sem_queue(current);
     // 释放文件系统
@@ -563,6 +633,9 @@ int __do_exit() {
             }
             process->parent = parent;
             parent->child = process;
+            if (process->vfork_parent == current) {
+                process->vfork_parent = NULL;
+            }
             if (process->state == STATE_ZOMBIE) {
                 // process已经结束，并且parent在等待子进程结束
                 if (parent->wait_state == WT_CHILD) {
@@ -603,12 +676,15 @@ int do_exit_thread(int error_code) {
 // load_icode -  called by sys_exec-->do_execve
 // 1. create a new mm for current process
 // 2. create a new PDT, and mm->pgdir= kernel virtual addr of PDT
-// 3. copy TEXT/DATA/BSS parts in binary to memory space of process
+// 3. setup vmas for TEXT/DATA/BSS parts in binary, pages are loaded on first access
 // 4. call mm_map to setup user stack, and put parameters into user stack
 // 5. setup trapframe for user environment
-static int load_icode(unsigned char *binary, size_t size) {
-    if (current->mm != NULL) {
-        panic("load_icode: current->mm must be empty.\n");
+// spawn时process为新创建的子进程，此时不需要加载它的页目录。
+// file为NULL时binary是常驻内核的整个映像；否则binary只是file开头的一个page，
+// size为file的大小，段的内容之后从file中读入
+static int load_icode(Process *process, unsigned char *binary, size_t size, Inode *file) {
+    if (process->mm != NULL) {
+        panic("load_icode: process->mm must be empty.\n");
     }
 
     int ret = -E_NO_MEM;
@@ -623,14 +699,16 @@ static int load_icode(unsigned char *binary, size_t size) {
         goto bad_page_dir_cleanup_mm;
     }
 
-    struct Page *page = NULL;
     struct Elf *elf = (struct Elf*)binary;
     struct ProgHeader *ph = (struct ProgHeader *)(binary + elf->e_phoff);
-    if (elf->e_magic != ELF_MAGIC) {
+    size_t header_size = (file != NULL) ? MIN(size, PAGE_SIZE) : size;
+    if (elf->e_magic != ELF_MAGIC ||
+        elf->e_phoff + elf->e_phnum * sizeof(struct ProgHeader) > header_size) {
         ret = -E_INVAL_ELF;
         goto bad_elf_cleanup_page_dir;
     }
-    uint32_t vm_flags, perm;
+    uint32_t vm_flags;
+    VmaStruct *vma;
     struct ProgHeader *ph_end = ph + elf->e_phnum;
     for (; ph < ph_end; ph++) {
         if (ph->p_type != ELF_PT_LOAD) {
@@ -639,16 +717,14 @@ static int load_icode(unsigned char *binary, size_t size) {
         }
         // file size 和mem size的关系是什么？
         // todo: 
-        if (ph->p_filesz > ph->p_memsz) {
+        if (ph->p_filesz > ph->p_memsz || ph->p_offset + ph->p_filesz > size) {
             ret = -E_INVAL_ELF;
             goto bad_cleanup_mmap;
         }
         if (ph->p_filesz == 0) {
             continue;
         }
-        vm_flags = 0;
-        // 用户态程序
-        perm = PTE_U;
+        vm_flags = VM_IMAGE;
         if (ph->p_flags & ELF_PF_X) {
             vm_flags |= VM_EXEC;
         }
@@ -658,74 +734,16 @@ static int load_icode(unsigned char *binary, size_t size) {
         if (ph->p_flags & ELF_PF_R) {
             vm_flags |= VM_READ;
         }
-        if (vm_flags & VM_WRITE) {
-            perm |= PTE_W;
-        }
-        if ((ret = mm_map(mm, ph->p_va, ph->p_memsz, vm_flags, NULL)) != 0) {
+        if ((ret = mm_map(mm, ph->p_va, ph->p_memsz, vm_flags, &vma)) != 0) {
             goto bad_cleanup_mmap;
         }
         // brk_start的值为从加载程序的最后的一个地址开始（以页向上对齐）
         if (mm->brk_start < ph->p_va + ph->p_memsz) {
             mm->brk_start = ph->p_va + ph->p_memsz;
         }
-        unsigned char *from = binary + ph->p_offset;
-        size_t off, size;
-        uintptr_t start = ph->p_va;
-        uintptr_t end;
-        uintptr_t va = ROUNDDOWN(start, PAGE_SIZE);
-        ret = -E_NO_MEM;
-
-        end = ph->p_va + ph->p_filesz;
-        printk("[start, end) = [%08x, %08x)\n", start, end);
-        // 将可加载段段的内容拷贝到对应的vma
-        while (start < end) {
-            if ((page = page_dir_alloc_page(mm->page_dir, va, perm)) == NULL) {
-                goto bad_cleanup_mmap;
-            }
-            off = start - va;
-            size = PAGE_SIZE - off;
-            va += PAGE_SIZE;
-            if (end < va) {
-                size -= (va - end);
-            }
-            memcpy(page2kva(page) + off, from, size);
-            start += size;
-            from += size;
-        }
-        end = ph->p_va + ph->p_memsz;
-
-        // start到va(va是页边界)还有有段空缺的内容没有使用
-        if (start < va) {
-            if (start == end) {
-                // 可执行文件中的filesz和memsz大小相等
-                continue;
-            }
-            // 可加载段的filesz和memsz的大小不相等，memsz大于filesz，
-            // 说明filesz到memsz之间需要填充零
-            // bss段就是filesz为0，而memsz为未初始化全局变量和局部静态变量的总大小
-            off = start + PAGE_SIZE - va;
-            size = PAGE_SIZE - off;
-            if (end < va) {
-                size -= (va - end);
-            }
-            memset(page2kva(page) + off, 0, size);
-            start += size;
-            assert((end < va && start == end) || (end >= va && start == va));
-        }
-
-        while (start < end) {
-            if ((page = page_dir_alloc_page(mm->page_dir, va, perm)) == NULL) {
-                goto bad_cleanup_mmap;
-            }
-            off = start - va;
-            size = PAGE_SIZE - off;
-            va += PAGE_SIZE;
-            if (end < va) {
-                size -= (va - end);
-            }
-            memset(page2kva(page) + off, 0, size);
-            start += size;
-        }
+        // 段的内容只记录在vma中，第一次访问时由do_page_fault读入
+        printk("[start, end) = [%08x, %08x)\n", ph->p_va, ph->p_va + ph->p_filesz);
+        vma_set_image(vma, file, binary, ph->p_offset, ph->p_va, ph->p_filesz);
     }
     // brk == brk_start说明还没有分配任何堆内存
     mm->brk_start = mm->brk = ROUNDUP(mm->brk_start, PAGE_SIZE);
@@ -735,6 +753,10 @@ static int load_icode(unsigned char *binary, size_t size) {
     if ((ret = mm_map(mm, USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_SIZE, vm_flags, NULL)) != 0) {
         goto bad_cleanup_mmap;
     }
+    if ((ret = vdso_map(mm)) != 0) {
+        goto bad_cleanup_mmap;
+    }
+    vdso_set_pid(mm, process->pid);
     bool intr_flag;
     local_intr_save(intr_flag);
     {
@@ -743,11 +765,13 @@ static int load_icode(unsigned char *binary, size_t size) {
     local_intr_restore(intr_flag);
 
     mm_count_inc(mm);
-    current->mm = mm;
-    current->page_dir = (uintptr_t)mm->page_dir;
-    lcr3(PADDR(mm->page_dir));
+    process->mm = mm;
+    process->page_dir = (uintptr_t)mm->page_dir;
+    if (process == current) {
+        load_page_dir(mm->page_dir);
+    }
 
-    struct TrapFrame *tf = current->tf;
+    struct TrapFrame *tf = process->tf;
     memset(tf, 0, sizeof(struct TrapFrame));
 
     tf->tf_cs = USER_CS;
@@ -771,29 +795,12 @@ bad_mm:
     return ret;
 }
 
-int do_execve(const char *name, size_t len, unsigned char *binary, size_t size) {
+// 释放current原来的地址空间等资源，然后加载binary
+static int exec_binary(const char *name, unsigned char *binary, size_t size, Inode *file) {
     MmStruct *mm = current->mm;
-
-    if (len > PROCESS_NAME_LEN) {
-        len = PROCESS_NAME_LEN;
-    }
-
-    char local_name[PROCESS_NAME_LEN + 1];
-    memset(local_name, 0, sizeof(local_name));
-
-    lock_mm(mm);
-    {
-        if (!copy_from_user(mm, local_name, name, len, 0)) {
-            unlock_mm(mm);
-            return -E_INVAL;
-        }
-    }
-    unlock_mm(mm);
-    
-    
     if (mm != NULL) {
         // 切换到内核地址空间，因为进程mm要被释放掉了
-        lcr3(PADDR(get_boot_page_dir()));
+        load_page_dir(get_boot_page_dir());
         if (mm_count_dec(mm) == 0) {
             // 释放所有页表项映射的page，以及释放所有的页表，最后只留下一个页目录
             exit_mmap(mm);
@@ -810,6 +817,10 @@ int do_execve(const char *name, size_t len, unsigned char *binary, size_t size)
         }
         current->mm = NULL;
     }
+    // vfork的父进程可以继续运行了
+    vfork_release();
+    // 新的程序从初始的fpu状态开始
+    fpu_release(current);
     // 将当前的信号量释放掉
     put_sem_queue(current);
     put_fs(current);
@@ -827,10 +838,10 @@ int do_execve(const char *name, size_t len, unsigned char *binary, size_t size)
     sem_queue_ref_inc(current->sem_queue);
 
     // 加载新的进程地址空间到current
-    if ((ret = load_icode(binary, size)) != 0) {
+    if ((ret = load_icode(current, binary, size, file)) != 0) {
         goto execve_exit;
     }
-    set_process_name(current, local_name);
+    set_process_name(current, name);
     // 当前进程为为新的内存地址空间
     // todo: 为什么execve新进程后将其从线程组中移除
     delete_thread(current);
@@ -842,11 +853,204 @@ execve_exit:
     panic("already exit: %e.\n", ret);
 }
 
+int do_execve(const char *name, size_t len, unsigned char *binary, size_t size) {
+    MmStruct *mm = current->mm;
+
+    if (len > PROCESS_NAME_LEN) {
+        len = PROCESS_NAME_LEN;
+    }
+
+    char local_name[PROCESS_NAME_LEN + 1];
+    memset(local_name, 0, sizeof(local_name));
+
+    lock_mm(mm);
+    {
+        if (!copy_from_user(mm, local_name, name, len, 0)) {
+            unlock_mm(mm);
+            return -E_INVAL;
+        }
+    }
+    unlock_mm(mm);
+    return exec_binary(local_name, binary, size, NULL);
+}
+
+// 打开文件系统中的可执行文件，只读入文件开头的一个page(ELF头和程序头)，
+// 段的内容由load_icode记录下来按需读入。调用者负责释放page并关闭file
+static int read_binary(char *path, struct Page **page_store, size_t *size_store, Inode **file_store) {
+    int ret;
+    Inode *node = NULL;
+    if ((ret = vfs_open(path, O_RDONLY, &node)) != 0) {
+        return ret;
+    }
+    Stat __stat, *stat = &__stat;
+    if ((ret = vop_fstat(node, stat)) != 0) {
+        goto failed;
+    }
+    ret = -E_INVAL_ELF;
+    if (stat->st_size < sizeof(struct Elf)) {
+        goto failed;
+    }
+    ret = -E_NO_MEM;
+    struct Page *page = NULL;
+    if ((page = alloc_page()) == NULL) {
+        goto failed;
+    }
+    size_t len = MIN(stat->st_size, PAGE_SIZE);
+    IOBuf __iob, *iob = iobuf_init(&__iob, page2kva(page), len, 0);
+    if ((ret = vop_read(node, iob)) != 0 || iobuf_used(iob) != len) {
+        free_page(page);
+        if (ret == 0) {
+            ret = -E_INVAL_ELF;
+        }
+        goto failed;
+    }
+    *page_store = page;
+    *size_store = stat->st_size;
+    *file_store = node;
+    return 0;
+failed:
+    vfs_close(node);
+    return ret;
+}
+
+// 进程名为路径的最后一部分
+static void path_to_name(char *name, const char *path) {
+    const char *base = path;
+    for (; *path != '\0'; path++) {
+        if (*path == '/' || *path == ':') {
+            base = path + 1;
+        }
+    }
+    memset(name, 0, PROCESS_NAME_LEN + 1);
+    strncpy(name, base, PROCESS_NAME_LEN);
+}
+
+// 执行文件系统中的程序
+int do_execve_file(const char *__path) {
+    int ret;
+    char *path = NULL;
+    if ((ret = copy_path(&path, __path)) != 0) {
+        return ret;
+    }
+    struct Page *page = NULL;
+    size_t size;
+    Inode *file = NULL;
+    // 必须在释放fs_struct之前打开，path可能是相对于当前目录的路径
+    ret = read_binary(path, &page, &size, &file);
+    if (ret != 0) {
+        kfree(path);
+        return ret;
+    }
+    char local_name[PROCESS_NAME_LEN + 1];
+    path_to_name(local_name, path);
+    kfree(path);
+
+    // 加载失败时exec_binary直接退出进程，不会返回
+    ret = exec_binary(local_name, page2kva(page), size, file);
+    free_page(page);
+    vfs_close(file);
+    return ret;
+}
+
+// 创建一个执行path的子进程，子进程的地址空间直接由load_icode建立，
+// 不需要像fork+exec那样先复制父进程的地址空间再丢弃
+int do_spawn(const char *__path) {
+    int ret;
+    char *path = NULL;
+    if ((ret = copy_path(&path, __path)) != 0) {
+        return ret;
+    }
+    struct Page *page = NULL;
+    size_t size;
+    Inode *file = NULL;
+    if ((ret = read_binary(path, &page, &size, &file)) != 0) {
+        goto out_free_path;
+    }
+
+    Process *process = NULL;
+    ret = -E_NO_FREE_PROCESS;
+    if (nr_process >= MAX_PROCESS) {
+        goto out_free_binary;
+    }
+    ret = -E_NO_MEM;
+    if ((process = alloc_process()) == NULL) {
+        goto out_free_binary;
+    }
+
+    process->parent = current;
+    process->nice = current->nice;
+    process->time_slice = current->time_slice >> 1;
+    current->time_slice -= process->time_slice;
+
+    if (setup_kstack(process) != 0) {
+        goto bad_spawn_cleanup_process;
+    }
+    // 与exec一样，子进程使用新的fs_struct和信号量
+    if ((process->fs_struct = fs_create()) == NULL) {
+        goto bad_spawn_cleanup_kstack;
+    }
+    fs_count_inc(process->fs_struct);
+    if ((process->sem_queue = sem_queue_create()) == NULL) {
+        goto bad_spawn_cleanup_fs;
+    }
+    sem_queue_ref_inc(process->sem_queue);
+
+    process->tf = (struct TrapFrame *)(process->kstack + K_STACK_SIZE) - 1;
+    if ((ret = load_icode(process, page2kva(page), size, file)) != 0) {
+        goto bad_spawn_cleanup_sem;
+    }
+    process->context.eip = (uintptr_t)forkret;
+    process->context.esp = (uintptr_t)(process->tf);
+
+    char local_name[PROCESS_NAME_LEN + 1];
+    path_to_name(local_name, path);
+    set_process_name(process, local_name);
+
+    bool flag;
+    local_intr_save(flag);
+    {
+        process->pid = get_pid();
+        vdso_set_pid(process->mm, process->pid);
+        hash_process(process);
+        set_links(process);
+    }
+    local_intr_restore(flag);
+
+    wakeup_process(process);
+    ret = process->pid;
+
+out_free_binary:
+    free_page(page);
+    vfs_close(file);
+out_free_path:
+    kfree(path);
+    return ret;
+
+bad_spawn_cleanup_sem:
+    put_sem_queue(process);
+bad_spawn_cleanup_fs:
+    put_fs(process);
+bad_spawn_cleanup_kstack:
+    put_kstack(process);
+bad_spawn_cleanup_process:
+    kmem_cache_free(process_cachep, process);
+    goto out_free_binary;
+}
+
 int do_yield(void) {
     current->need_resched = 1;
     return 0;
 }
 
+// 设置当前进程的nice值，当前进程不在运行队列中，下次入队时按新的权重计算
+int do_nice(int nice) {
+    if (nice < NICE_MIN || nice > NICE_MAX) {
+        return -E_INVAL;
+    }
+    current->nice = nice;
+    return 0;
+}
+
 // 等待进程的孩子结束，此时如果进程在线程组中，如果进程没有ZOMBIE状态的孩子，那么就查找线程组中其他线程的孩子是否存于ZOMBIE状态
 int do_wait(int pid, int *code_store) {
     MmStruct *mm = current->mm;
@@ -914,13 +1118,15 @@ found:
     {
         unhash_process(process);
         remove_links(process);
+        put_pid(process->pid);
         // 在进程执行__do_exit时，已经从线程组中将进程移除了
         // delete_thread(process);
     }
     local_intr_restore(flag);
     // ZOMBIE状态的process堆栈是没有释放的，这个堆栈可以用来调试
     put_kstack(process);
-    kfree(process);
+    fpu_release(process);
+    kmem_cache_free(process_cachep, process);
 
     int ret = 0;
     if (code_store != NULL) {
@@ -1017,6 +1223,97 @@ int do_sleep(unsigned int time) {
     return 0;
 }
 
+int do_clock_gettime(int clock_id, struct timespec *ts) {
+    MmStruct *mm = current->mm;
+    if (clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC) {
+        return -E_INVAL;
+    }
+    struct timespec now;
+    ns_to_timespec(get_clock_ns(), &now);
+
+    int ret = 0;
+    lock_mm(mm);
+    if (!copy_to_user(mm, ts, &now, sizeof(struct timespec))) {
+        ret = -E_INVAL;
+    }
+    unlock_mm(mm);
+    return ret;
+}
+
+// 睡眠到高精度定时器到期，定时器比deadline提前hrtimer_slack_ns到期，剩下的时间释放大内核锁后忙等
+static int hrtimer_sleep(uint64_t deadline) {
+    bool flag;
+    HrTimer timer;
+    hrtimer_init(&timer, current, deadline - hrtimer_slack_ns);
+    local_intr_save(flag);
+    {
+        current->state = STATE_SLEEPING;
+        current->wait_state = WT_TIMER;
+        hrtimer_start(&timer);
+    }
+    local_intr_restore(flag);
+    schedule();
+
+    hrtimer_cancel(&timer);
+    if (current->flags & PF_EXITING) {
+        return -E_KILLED;
+    }
+    uint64_t now = get_clock_ns();
+    hrtimer_calibrate(now > timer.expires ? now - timer.expires : 0);
+    if (now < deadline) {
+        unlock_kernel();
+        while (get_clock_ns() < deadline) {
+            pause();
+        }
+        lock_kernel();
+    }
+    return 0;
+}
+
+// 纳秒级睡眠：两个tick以上的部分挂在时间轮上睡眠，时间轮在tick边界到期，
+// 醒来后剩下的部分用高精度定时器睡眠，只在最后很短的提前量内忙等
+int do_nanosleep(const struct timespec *req) {
+    MmStruct *mm = current->mm;
+    struct timespec ts;
+    lock_mm(mm);
+    if (!copy_from_user(mm, &ts, req, sizeof(struct timespec), false)) {
+        unlock_mm(mm);
+        return -E_INVAL;
+    }
+    unlock_mm(mm);
+    if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= NSEC_PER_SEC) {
+        return -E_INVAL;
+    }
+
+    uint64_t deadline = get_clock_ns() + timespec_to_ns(&ts);
+    while (1) {
+        uint64_t now = get_clock_ns();
+        if (now >= deadline) {
+            break;
+        }
+        uint64_t remain = deadline - now;
+        if (remain < 2 * TICK_NS) {
+            if (remain <= hrtimer_slack_ns) {
+                unlock_kernel();
+                while (get_clock_ns() < deadline) {
+                    pause();
+                }
+                lock_kernel();
+                break;
+            }
+            return hrtimer_sleep(deadline);
+        }
+        // 时间轮可能在第一个tick边界之前就到期，少睡一个tick
+        do_div(remain, TICK_NS);
+        remain--;
+        do_sleep(remain > 0x7FFFFFFF ? 0x7FFFFFFF : (unsigned int)remain);
+        if (current->flags & PF_EXITING) {
+            return -E_KILLED;
+        }
+    }
+    return 0;
+}
+
 // exec系统调用接口
 static int kernel_execve(const char *name, unsigned char *binary, size_t size) {
     int len = strlen(name);
@@ -1079,6 +1376,7 @@ static int init_main(void *arg) {
         panic("set boot fs failed: %e.\n", ret);
     }
 
+    shrink_caches(SHRINK_ALL);
     size_t nr_free_pages_store = nr_free_pages();
     size_t slab_allocated_store = slab_allocated();
     unsigned int nr_process_store = nr_process;
@@ -1116,6 +1414,7 @@ static int init_main(void *arg) {
     assert(kswapd->child == NULL);
     assert(kswapd->left_sibling == NULL);
     assert(kswapd->right_sibling == NULL);
+    shrink_caches(SHRINK_ALL);
     assert(nr_free_pages_store == nr_free_pages());
     assert(slab_allocated_store == slab_allocated());
 
@@ -1130,15 +1429,21 @@ void process_init(void) {
     for (i = 0; i < HASH_LIST_SIZE; i++) {
         list_init(hash_list + i);
     }
+    if ((process_cachep = kmem_cache_create("process", sizeof(Process), 0, NULL)) == NULL ||
+        (kstack_cachep = kmem_cache_create("kstack", K_STACK_SIZE, 0, NULL)) == NULL) {
+        panic("process_init: create slab cache failed.\n");
+    }
 
     if ((idle_process = alloc_process()) == NULL) {
         panic("can't alloc idle process\n");
     }
 
     idle_process->pid = 0;
+    pid_bitmap[0] |= 1;
     idle_process->state = STATE_RUNNABLE;
     idle_process->kstack = (uintptr_t)boot_stack;
     idle_process->need_resched = 1;
+    idle_process->cpu = 0;
     if ((idle_process->fs_struct = fs_create()) == NULL) {
         panic("create fs_struct(idle_process) failed.\n");
     }
@@ -1150,6 +1455,24 @@ void process_init(void) {
 
     current = idle_process;
 
+    // 其他cpu的idle进程，内核栈也是ap启动时使用的栈，这些idle进程不计入nr_process
+    for (i = 1; i < ncpu; i++) {
+        Process *idle;
+        struct Page *page;
+        if ((idle = alloc_process()) == NULL || (page = alloc_pages(K_STACK_PAGE)) == NULL) {
+            panic("can't alloc idle process for cpu %d\n", i);
+        }
+        idle->pid = 0;
+        idle->state = STATE_RUNNABLE;
+        idle->kstack = (uintptr_t)page2kva(page);
+        idle->need_resched = 1;
+        idle->fs_struct = idle_process->fs_struct;
+        fs_count_inc(idle->fs_struct);
+        idle->cpu = i;
+        snprintf(idle->name, sizeof(idle->name), "idle/%d", i);
+        cpus[i].idle = cpus[i].curr = idle;
+    }
+
     int pid = kernel_thread(init_main, "Hello world!", 0);
 
     if (pid <= 0) {
@@ -1319,10 +1642,17 @@ void print_current_thread_group(void) {
     printk("\n");
 }
 
+// 进入cpu_idle时持有大内核锁，idle循环等待时不持有锁，以便其他cpu进入内核
+// 没有进程可以运行时hlt，并尽量停止周期时钟(见tick.c)
 void cpu_idle(void) {
+    unlock_kernel();
     while (1) {
         if (current->need_resched) {
+            lock_kernel();
             schedule();
+            unlock_kernel();
+        } else {
+            tick_idle();
         }
     }
 }
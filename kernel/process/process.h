@@ -10,6 +10,7 @@
 
 #include <swap.h>
 #include <semaphore.h>
+#include <cpu.h>
 
 enum ProcessState {
     STATE_UNINIT = 0,
@@ -48,6 +49,10 @@ struct run_queue;
 
 struct fs_struct;
 
+struct timespec;
+
+struct prio_array;
+
 typedef struct process_struct {
     enum ProcessState state;
     int pid;
@@ -73,14 +78,31 @@ typedef struct process_struct {
     int time_slice;             // 进程占用CPU的时间片
     SemaphoreQueue *sem_queue;  // 进程等待的用户态信号量
     struct fs_struct *fs_struct;
+    int cpu;                    // 进程最近一次在哪个cpu上运行，-1表示还没有运行过
+    int nice;                   // nice值[-20, 19]，决定CFS中的权重
+    uint64_t vruntime;          // CFS的虚拟运行时间
+    rbtree_node_t run_node;     // CFS中链接进运行队列的红黑树
+    struct prio_array *array;   // O(1)调度中进程所在的优先级数组
+    int allotment_used;         // MLFQ中进程在当前级别累计运行的tick数
+    unsigned int boost_epoch;   // MLFQ中进程最近一次入队时的优先级提升轮次
+    void *fpu_state;            // fpu/sse状态的保存区，进程第一次使用fpu时才分配
+    int fpu_cpu;                // 最近一次在哪个cpu上使用fpu
+    struct process_struct *vfork_parent;    // vfork创建的子进程exec或者退出前，父进程一直在等待
+    int nr_page_faults;         // 进程发生缺页的次数
 } Process;
 
+// nice值的范围，与linux一致
+#define NICE_MIN                    (-20)
+#define NICE_MAX                    19
+
 #define PF_EXITING                  0x00000001  // getting shutdown
+#define PF_VFORK                    0x00000002  // 正在等待vfork的子进程exec或者退出
 
 #define WT_CHILD                    (0x00000001 | WT_INTERRUPTED)   // wait child
 #define WT_TIMER                    (0x00000002 | WT_INTERRUPTED)   // wait timer
 #define WT_KSWAPD                    0x00000003                     // wait kswapd to free page
 #define WT_KBD                      (0X00000004 | WT_INTERRUPTED)
+#define WT_VFORK                    (0x00000005 | WT_INTERRUPTED)   // wait vfork child
 #define WT_KSEM                      0x00000100                     // 等待内核态信号量
 #define WT_USEM                     (0x00000101 | WT_INTERRUPTED)   // 等待用户态信号量
                      
@@ -89,9 +111,11 @@ typedef struct process_struct {
 #define le2process(le, member)      \
     container_of((le), Process, member)
 
-extern Process *idle_process;
+// 每个cpu都有自己的idle进程和当前运行的进程
+#define idle_process    (this_cpu()->idle)
+#define current         (this_cpu()->curr)
+
 extern Process *init_process;
-extern Process *current;
 extern Process *kswapd;
 // Process *get_idle_process(void);
 // Process *get_init_process(void);
@@ -113,11 +137,16 @@ int do_fork(uint32_t clone_flags, uintptr_t statck, struct TrapFrame *tf);
 int do_exit(int error_code);
 int do_exit_thread(int error_code);
 int do_execve(const char *name, size_t len, unsigned char *binary, size_t size);
+int do_execve_file(const char *path);
+int do_spawn(const char *path);
 int do_yield(void);
+int do_nice(int nice);
 int do_wait(int pid, int *code_store);
 int do_kill(int pid, int error_code);
 int do_brk(uintptr_t *brk_store);
 int do_sleep(unsigned int time);
+int do_clock_gettime(int clock_id, struct timespec *ts);
+int do_nanosleep(const struct timespec *req);
 int do_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 int do_munmap(uintptr_t addr, size_t len);
 int do_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
@@ -3,57 +3,264 @@
 #include <schedule.h>
 #include <assert.h>
 #include <stdio.h>
+#include <cpu.h>
+#include <clock.h>
+#include <slab.h>
+#include <pmm.h>
+#include <x86.h>
+#include <tick.h>
+#include <trap.h>
 #include <schedule_FCFS.h>
 #include <schedule_RR.h>
 #include <schedule_MLFQ.h>
+#include <schedule_CFS.h>
+#include <schedule_O1.h>
 
-static ListEntry timer_list;
+// 分层时间轮：tv1有256个槽，每个槽对应一个tick，
+// tv2~tv5各有64个槽，每个槽分别对应256、256*64、256*64^2、256*64^3个tick。
+// 定时器按到期时间挂到对应的槽中，插入和删除都是O(1)；
+// tv1转完一圈时把上一级中对应槽的定时器重新分配到下一级(cascade)，到期处理均摊O(1)
+#define TVR_BITS        8
+#define TVN_BITS        6
+#define TVR_SIZE        (1 << TVR_BITS)
+#define TVN_SIZE        (1 << TVN_BITS)
+#define TVR_MASK        (TVR_SIZE - 1)
+#define TVN_MASK        (TVN_SIZE - 1)
+#define TVN_NUM         4
 
-static ScheduleClass *schedule_class;
+static ListEntry tv1[TVR_SIZE];
+static ListEntry tvn[TVN_NUM][TVN_SIZE];
+// 时间轮下一个要处理的tick
+static unsigned int timer_ticks;
+// 时间轮中的定时器个数
+static unsigned int nr_timers;
+
+// 第n级(tv2为0)中expires所在的槽
+#define TVN_INDEX(expires, n)   \
+    (((expires) >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+// 根据定时器的到期时间(绝对tick)挂到时间轮对应的槽中
+static void timer_wheel_add(Timer *timer) {
+    unsigned int expires = timer->expires;
+    unsigned int delta = expires - timer_ticks;
+    ListEntry *slot;
+    if ((int)delta < 0) {
+        // 已经到期的定时器在下一个tick处理
+        slot = &tv1[timer_ticks & TVR_MASK];
+    } else if (delta < TVR_SIZE) {
+        slot = &tv1[expires & TVR_MASK];
+    } else if (delta < (1 << (TVR_BITS + TVN_BITS))) {
+        slot = &tvn[0][TVN_INDEX(expires, 0)];
+    } else if (delta < (1 << (TVR_BITS + 2 * TVN_BITS))) {
+        slot = &tvn[1][TVN_INDEX(expires, 1)];
+    } else if (delta < (1 << (TVR_BITS + 3 * TVN_BITS))) {
+        slot = &tvn[2][TVN_INDEX(expires, 2)];
+    } else {
+        slot = &tvn[3][TVN_INDEX(expires, 3)];
+    }
+    list_add_before(slot, &(timer->timer_link));
+}
+
+// 把第n级index槽中的定时器重新分配到更低的级别中，返回index
+static int timer_wheel_cascade(int n, int index) {
+    ListEntry *slot = &tvn[n][index];
+    ListEntry list;
+    list_init(&list);
+    if (!list_empty(slot)) {
+        // 把整个槽的链表摘下来，再逐个重新插入
+        list_add(slot, &list);
+        list_del_init(slot);
+    }
+    while (!list_empty(&list)) {
+        Timer *timer = le2timer(list_next(&list), timer_link);
+        list_del_init(&(timer->timer_link));
+        timer_wheel_add(timer);
+    }
+    return index;
+}
+
+static void timer_wheel_init(void) {
+    int i, n;
+    for (i = 0; i < TVR_SIZE; i++) {
+        list_init(&tv1[i]);
+    }
+    for (n = 0; n < TVN_NUM; n++) {
+        for (i = 0; i < TVN_SIZE; i++) {
+            list_init(&tvn[n][i]);
+        }
+    }
+    timer_ticks = 0;
+    nr_timers = 0;
+}
+
+// 让cpu尽快调度新入队的进程：在idle中hlt或者停止了周期时钟的cpu需要ipi唤醒
+static void resched_cpu(Cpu *cpu) {
+    Cpu *self = this_cpu();
+    if (cpu->curr == cpu->idle) {
+        cpu->idle->need_resched = true;
+    }
+    if (cpu == self) {
+        if (cpu->tick_stopped && cpu->curr != cpu->idle) {
+            tick_restart(cpu);
+            cpu->curr->need_resched = true;
+        }
+    } else if (cpu->curr == cpu->idle || cpu->tick_stopped) {
+        lapic_send_ipi(cpu->apic_id, T_IPI_RESCHED);
+    }
+    // bsp只在所有cpu都空闲时才停止周期时钟，有cpu开始运行进程时要让它恢复，继续推进系统时间
+    if (cpu != &cpus[0] && self != &cpus[0] && cpus[0].tick_stopped) {
+        lapic_send_ipi(cpus[0].apic_id, T_IPI_RESCHED);
+    }
+}
 
-static RunQueue *run_queue;
+static ScheduleClass *schedule_class;
 
-static inline void schedule_class_enqueue(Process *process) {
-    if (process != idle_process) {
-        schedule_class->enqueue(run_queue, process);
+// 每个cpu都有自己的运行队列，schedule_class的各个操作都作用在cpu->rq上
+static inline void schedule_class_enqueue(Cpu *cpu, Process *process) {
+    if (process != cpu->idle) {
+        schedule_class->enqueue(cpu->rq, process);
+        cpu->nr_running++;
     }
 }
 
-static inline void schedule_class_dequeue(Process *process) {
-    schedule_class->dequeue(run_queue, process);
+static inline void schedule_class_dequeue(Cpu *cpu, Process *process) {
+    schedule_class->dequeue(cpu->rq, process);
+    cpu->nr_running--;
 }
 
-static inline Process *schedule_class_pick_next(void) {
-    return schedule_class->pick_next(run_queue);
+static inline Process *schedule_class_pick_next(Cpu *cpu) {
+    return schedule_class->pick_next(cpu->rq);
 }
 
-static void schedule_class_process_tick(Process *process) {
-    if (process != idle_process) {
-        schedule_class->process_tick(run_queue, process);
+static void schedule_class_process_tick(Cpu *cpu, Process *process) {
+    if (process != cpu->idle) {
+        schedule_class->process_tick(cpu->rq, process);
     } else {
         // printk("process = %p rescheduled\n", process);
         process->need_resched = true;
     }
 }
 
-static RunQueue __run_quque[4];
+// MLFQ每个cpu使用4级队列
+#define RUN_QUEUE_LEVEL     4
 
-void schedule_init(void) {
-    list_init(&timer_list);
+static RunQueue __run_quque[NCPU][RUN_QUEUE_LEVEL];
+
+// cpu的负载：运行队列中的进程数加上正在运行的进程
+static inline unsigned int cpu_load(Cpu *cpu) {
+    return cpu->nr_running + (cpu->curr != cpu->idle ? 1 : 0);
+}
+
+// 进程已经运行过则放回上次运行的cpu(cache亲和性)，否则放到负载最小的cpu上
+static Cpu *select_cpu(Process *process) {
+    if (process->cpu >= 0) {
+        return &cpus[process->cpu];
+    }
+    Cpu *best = this_cpu();
+    int i;
+    for (i = 0; i < ncpu; i++) {
+        if (cpus[i].started && cpu_load(&cpus[i]) < cpu_load(best)) {
+            best = &cpus[i];
+        }
+    }
+    return best;
+}
+
+static inline bool process_on_cpu(Process *process) {
+    return process->cpu >= 0 && cpus[process->cpu].curr == process;
+}
+
+// 负载最大的cpu，只有在它的运行队列中还有等待的进程时才返回
+static Cpu *find_busiest_cpu(Cpu *self) {
+    Cpu *busiest = NULL;
+    int i;
+    for (i = 0; i < ncpu; i++) {
+        Cpu *cpu = &cpus[i];
+        if (cpu == self || !cpu->started || cpu->nr_running == 0) {
+            continue;
+        }
+        if (busiest == NULL || cpu_load(cpu) > cpu_load(busiest)) {
+            busiest = cpu;
+        }
+    }
+    return busiest;
+}
+
+// 将from运行队列中的下一个进程取出，迁移到to上
+static Process *migrate_process(Cpu *from, Cpu *to) {
+    Process *process = schedule_class_pick_next(from);
+    if (process != NULL) {
+        schedule_class_dequeue(from, process);
+        process->cpu = to->id;
+        to->nr_migrations++;
+    }
+    return process;
+}
 
-    run_queue = __run_quque;
-    list_init(&(run_queue->rq_link));
-    run_queue->max_time_slice = 8;
+// 当前cpu没有可运行的进程时，从最忙的cpu上偷一个进程过来直接运行
+static Process *steal_process(Cpu *cpu) {
+    Cpu *busiest = find_busiest_cpu(cpu);
+    if (busiest == NULL || cpu_load(busiest) < 2) {
+        return NULL;
+    }
+    return migrate_process(busiest, cpu);
+}
+
+// 每隔BALANCE_INTERVAL个tick由bsp调用一次，在最忙和最闲的cpu之间平摊运行队列
+#define BALANCE_INTERVAL    100
+
+static void load_balance(void) {
+    Cpu *busiest = NULL, *idlest = NULL;
     int i;
-    for (i = 1; i < ARRAY_SIZE(__run_quque); i++) {
-        list_add_before(&(run_queue->rq_link), &(__run_quque[i].rq_link));
-        __run_quque[i].max_time_slice = run_queue->max_time_slice * (1 << i);
+    for (i = 0; i < ncpu; i++) {
+        Cpu *cpu = &cpus[i];
+        if (!cpu->started) {
+            continue;
+        }
+        if (busiest == NULL || cpu_load(cpu) > cpu_load(busiest)) {
+            busiest = cpu;
+        }
+        if (idlest == NULL || cpu_load(cpu) < cpu_load(idlest)) {
+            idlest = cpu;
+        }
     }
-    
+    if (busiest == NULL || busiest == idlest) {
+        return;
+    }
+
+    unsigned int nr_move = (cpu_load(busiest) - cpu_load(idlest)) / 2;
+    while (nr_move-- > 0 && busiest->nr_running > 0) {
+        Process *process = migrate_process(busiest, idlest);
+        schedule_class_enqueue(idlest, process);
+    }
+    if (idlest->nr_running > 0) {
+        resched_cpu(idlest);
+    }
+}
+
+void schedule_init(void) {
+    timer_wheel_init();
+
     schedule_class = get_MLFQ_schedule_class();
     // schedule_class = get_RR_schedule_class();
     // schedule_class = get_FCFS_schedule_class();
-    schedule_class->init(run_queue);
+    // schedule_class = get_CFS_schedule_class();
+    // schedule_class = get_O1_schedule_class();
+
+    int i, j;
+    for (i = 0; i < NCPU; i++) {
+        RunQueue *run_queue = __run_quque[i];
+        list_init(&(run_queue->rq_link));
+        run_queue->max_time_slice = 8;
+        for (j = 1; j < RUN_QUEUE_LEVEL; j++) {
+            list_add_before(&(run_queue->rq_link), &(__run_quque[i][j].rq_link));
+            __run_quque[i][j].max_time_slice = run_queue->max_time_slice * (1 << j);
+        }
+        schedule_class->init(run_queue);
+        cpus[i].rq = run_queue;
+        cpus[i].nr_running = 0;
+        list_init(&(cpus[i].hrtimers));
+    }
 
     printk("schedule class: %s\n", schedule_class->name);
 }
@@ -66,8 +273,10 @@ void wakeup_process(Process *process) {
         if (process->state != STATE_RUNNABLE) {
             process->state = STATE_RUNNABLE;
             process->wait_state = 0;
-            if (process != current) {
-                schedule_class_enqueue(process);
+            if (!process_on_cpu(process)) {
+                Cpu *cpu = select_cpu(process);
+                schedule_class_enqueue(cpu, process);
+                resched_cpu(cpu);
             }
         } else {
             warn("wakeup runnable process.\n");
@@ -80,6 +289,7 @@ void wakeup_process(Process *process) {
 void schedule(void) {
     bool flag;
     Process *next = NULL;
+    Cpu *cpu = this_cpu();
     local_intr_save(flag);
     {
         current->need_resched = false;
@@ -88,10 +298,12 @@ void schedule(void) {
             // 当前进程还可以继续被调度
             // printk("current process pid = %d enqueue, name = %s, state = %08x, wait_state=%08x, res=%d\n",
                 // current->pid, current->name, current->state, current->wait_state, current->need_resched);
-            schedule_class_enqueue(current);
+            schedule_class_enqueue(cpu, current);
         }
-        if ((next = schedule_class_pick_next()) != NULL) {
-            schedule_class_dequeue(next);
+        if ((next = schedule_class_pick_next(cpu)) != NULL) {
+            schedule_class_dequeue(cpu, next);
+        } else {
+            next = steal_process(cpu);
         }
         if (next == NULL) {
             next = idle_process;
@@ -99,6 +311,7 @@ void schedule(void) {
         // printk("next process pid = %d, name = %s, state = %08x, wait_state=%08x, res=%d\n",
             // next->pid, next->name, next->state, next->wait_state, next->need_resched);
         next->runs++;
+        next->cpu = cpu->id;
         if (next != current) {
             process_run(next);
         }
@@ -106,23 +319,16 @@ void schedule(void) {
     local_intr_restore(flag);
 }
 
+// timer->expires为相对当前的tick数，插入时换算成时间轮上的绝对tick
 void add_timer(Timer *timer) {
     bool flag;
     local_intr_save(flag);
     {
         assert(timer->expires > 0 && timer->process != NULL);
         assert(list_empty(&(timer->timer_link)));
-        ListEntry *entry = list_next(&timer_list);
-        while (entry != &timer_list) {
-            Timer *next = le2timer(entry, timer_link);
-            if (timer->expires < next->expires) {
-                next->expires -= timer->expires;
-                break;
-            }
-            timer->expires -= next->expires;
-            entry = list_next(entry);
-        }
-        list_add_before(entry, &(timer->timer_link));
+        timer->expires += timer_ticks - 1;
+        timer_wheel_add(timer);
+        nr_timers++;
     }
     local_intr_restore(flag);
 }
@@ -133,47 +339,136 @@ void del_timer(Timer *timer) {
     local_intr_save(flag);
     {
         if (!list_empty(&(timer->timer_link))) {
-            if (timer->expires != 0) {
-                ListEntry *entry = list_next(&timer->timer_link);
-                if (entry != &timer_list) {
-                    Timer *next = le2timer(entry, timer_link);
-                    next->expires += timer->expires;
-                }
-            }
             list_del_init(&(timer->timer_link));
+            nr_timers--;
+        }
+    }
+    local_intr_restore(flag);
+}
+
+// 推进时间轮一个tick，唤醒在这个tick到期的进程
+static void run_timer_wheel(void) {
+    int index = timer_ticks & TVR_MASK;
+    if (index == 0) {
+        // tv1转完一圈，依次从上一级补充定时器，只有上一级也转完一圈才继续向上
+        int n;
+        for (n = 0; n < TVN_NUM; n++) {
+            if (timer_wheel_cascade(n, TVN_INDEX(timer_ticks, n)) != 0) {
+                break;
+            }
+        }
+    }
+    timer_ticks++;
+
+    ListEntry *slot = &tv1[index];
+    while (!list_empty(slot)) {
+        Timer *timer = le2timer(list_next(slot), timer_link);
+        Process *process = timer->process;
+        if (process->wait_state != 0) {
+            assert(process->wait_state & WT_INTERRUPTED);
+        } else {
+            warn("process %d's wait_state == 0.\n", process->pid);
+        }
+        wakeup_process(process);
+        del_timer(timer);
+    }
+}
+
+// 距离时间轮下一次需要处理(有定时器到期或者tv1转完一圈需要级联)还有多少个tick，
+// 没有定时器时返回0。bsp在idle时据此设置一次性定时器
+unsigned int next_timer_ticks(void) {
+    if (nr_timers == 0) {
+        return 0;
+    }
+    int index = timer_ticks & TVR_MASK;
+    int i;
+    for (i = index; i < TVR_SIZE; i++) {
+        if (!list_empty(&tv1[i])) {
+            return i - index + 1;
+        }
+    }
+    return TVR_SIZE - index + 1;
+}
+
+// 停止周期时钟期间错过了n个tick，依次推进时间轮
+void run_timer_ticks(unsigned int n) {
+    bool flag;
+    local_intr_save(flag);
+    {
+        while (n-- > 0) {
+            run_timer_wheel();
         }
     }
     local_intr_restore(flag);
 }
 
-// 每个时钟滴答执行一次，我们的滴答为10ms一次
+// 每个时钟滴答执行一次，我们的滴答为1ms一次(TICK_HZ)
+// 每个cpu的时钟中断都会调用，但时间轮只由bsp推进
 void run_timer_list(void) {
     bool flag;
+    Cpu *cpu = this_cpu();
     local_intr_save(flag);
     {
-        ListEntry *entry = list_next(&timer_list);
-        if (entry != &timer_list) {
-            Timer *timer = le2timer(entry, timer_link);
-            assert(timer->expires != 0);
-            timer->expires--;
-            while (timer->expires == 0) {
-                entry = list_next(entry);
-                Process *process = timer->process;
-                if (process->wait_state != 0) {
-                    assert(process->wait_state & WT_INTERRUPTED);
-                } else {
-                    warn("process %d's wait_state == 0.\n", process->pid);
-                }
-                wakeup_process(process);
-                del_timer(timer);
-                if (entry == &timer_list) {
-                    break;
-                }
-                timer = le2timer(entry, timer_link);
-            }
+        if (cpu->id == 0) {
+            run_timer_wheel();
+        }
+        if (cpu->id == 0 && ncpu > 1 && get_ticks() % BALANCE_INTERVAL == 0) {
+            load_balance();
         }
         // 根据系统滴答来给当前进程计时
-        schedule_class_process_tick(current);
+        schedule_class_process_tick(cpu, current);
+    }
+    local_intr_restore(flag);
+}
+
+// 定时器的微基准测试：插入n个到期时间分散在各级时间轮中的定时器，再全部删除，
+// 统计每次插入和删除平均花费的cpu周期。这些定时器在到期前就被删除，不会唤醒进程
+void timer_benchmark(int n) {
+    // 上万个timer超过了kmalloc的最大大小，直接分配连续的page
+    size_t npages = ROUNDUP_DIV(sizeof(Timer) * n, PAGE_SIZE);
+    struct Page *page = alloc_pages(npages);
+    if (page == NULL) {
+        printk("timer benchmark: no memory for %d timers.\n", n);
+        return;
+    }
+    Timer *timers = page2kva(page);
+    int i;
+    for (i = 0; i < n; i++) {
+        // 到期时间至少1s，最长约10分钟
+        timer_init(&timers[i], current, TICK_HZ + (i * 7919) % (600 * TICK_HZ));
+    }
+
+    bool flag;
+    uint64_t start, add_cycles, del_cycles;
+    local_intr_save(flag);
+    {
+        start = read_tsc();
+        for (i = 0; i < n; i++) {
+            add_timer(&timers[i]);
+        }
+        add_cycles = read_tsc() - start;
+
+        start = read_tsc();
+        for (i = 0; i < n; i++) {
+            del_timer(&timers[i]);
+        }
+        del_cycles = read_tsc() - start;
     }
     local_intr_restore(flag);
-}
\ No newline at end of file
+    free_pages(page, npages);
+
+    printk("timer benchmark: %d timers, add %u cycles/op, del %u cycles/op.\n",
+        n, (uint32_t)add_cycles / n, (uint32_t)del_cycles / n);
+}
+
+void print_schedule(void) {
+    int i;
+    printk("schedule class: %s\n", schedule_class->name);
+    for (i = 0; i < ncpu; i++) {
+        Cpu *cpu = &cpus[i];
+        printk("cpu %d: apic %d, %s, current pid %d, runnable %u, migrated in %u\n",
+            cpu->id, cpu->apic_id, cpu->started ? "up" : "down",
+            cpu->curr != NULL ? cpu->curr->pid : -1,
+            cpu->nr_running, cpu->nr_migrations);
+    }
+}
@@ -4,6 +4,7 @@
 #include <process.h>
 #include <types.h>
 #include <list.h>
+#include <rbtree.h>
 
 
 typedef struct timer_t {
@@ -22,11 +23,27 @@ static inline Timer *timer_init(Timer *timer, Process *process, int expires) {
     return timer;
 }
 
+// O(1)调度的优先级数组，bitmap的第i位表示queue[i]非空，优先级数值越小越优先
+#define PRIO_LEVELS     32
+
+typedef struct prio_array {
+    uint32_t bitmap;
+    unsigned int nr_active;
+    ListEntry queue[PRIO_LEVELS];
+} PrioArray;
+
 typedef struct run_queue {
     ListEntry run_list;
     unsigned int process_count;
     int max_time_slice;
     ListEntry rq_link;
+    rbtree_t run_tree;          // CFS: 按vruntime排序的可运行进程
+    uint64_t min_vruntime;      // CFS: 队列中最小的vruntime，只增不减
+    unsigned int total_weight;  // CFS: 队列中进程的权重之和
+    PrioArray *active;          // O(1): 时间片没有用完的进程
+    PrioArray *expired;         // O(1): 时间片已经用完的进程，active为空时两者交换
+    PrioArray arrays[2];
+    unsigned int boost_epoch;   // MLFQ: 队列最近一次做优先级提升的轮次
 } RunQueue;
 
 #define le2runqueue(le, member)     \
@@ -47,5 +64,9 @@ void wakeup_process(Process *process);
 void add_timer(Timer *timer);
 void del_timer(Timer *timer);
 void run_timer_list(void);
+unsigned int next_timer_ticks(void);
+void run_timer_ticks(unsigned int n);
+void print_schedule(void);
+void timer_benchmark(int n);
 
 #endif // __KERNEL_SCHEDULE_SCHEDULE_H__
\ No newline at end of file
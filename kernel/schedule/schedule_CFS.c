@@ -0,0 +1,146 @@
+#include <schedule_CFS.h>
+#include <rbtree.h>
+#include <assert.h>
+#include <process.h>
+#include <clock.h>
+#include <types.h>
+
+// 完全公平调度：按照虚拟运行时间vruntime排序，每次选择vruntime最小的进程运行。
+// 进程每运行一个tick，vruntime增加 TICK_NS * NICE_0_WEIGHT / weight，
+// nice值越小权重越大，vruntime增长越慢，因而获得更多的cpu时间。
+
+// nice值为0的进程的权重
+#define NICE_0_WEIGHT       1024
+// 调度周期(tick)，运行队列中的进程按权重分这段时间
+#define SCHED_LATENCY       20
+// 进程一次至少运行的tick数
+#define SCHED_MIN_GRANULARITY   1
+// 睡眠醒来的进程最多比min_vruntime领先这么多，避免长时间睡眠的进程醒来后独占cpu
+#define SCHED_SLEEPER_BONUS     ((uint64_t)(SCHED_LATENCY / 2) * TICK_NS)
+
+// nice值[-20, 19]到权重的映射，相邻两级相差约1.25倍(取自linux的prio_to_weight)
+static const unsigned int nice_to_weight[40] = {
+    /* -20 */     88761,     71755,     56483,     46273,     36291,
+    /* -15 */     29154,     23254,     18705,     14949,     11916,
+    /* -10 */      9548,      7620,      6100,      4904,      3906,
+    /*  -5 */      3121,      2501,      1991,      1586,      1277,
+    /*   0 */      1024,       820,       655,       526,       423,
+    /*   5 */       335,       272,       215,       172,       137,
+    /*  10 */       110,        87,        70,        56,        45,
+    /*  15 */        36,        29,        23,        18,        15,
+};
+
+static inline unsigned int process_weight(Process *process) {
+    return nice_to_weight[process->nice - NICE_MIN];
+}
+
+static inline Process *node2process(rbtree_node_t *node) {
+    return container_of(node, Process, run_node);
+}
+
+static int CFS_compare(rbtree_node_t *node1, rbtree_node_t *node2) {
+    Process *p1 = node2process(node1);
+    Process *p2 = node2process(node2);
+    if (p1->vruntime < p2->vruntime) {
+        return -1;
+    } else if (p1->vruntime > p2->vruntime) {
+        return 1;
+    }
+    return 0;
+}
+
+// vruntime最小的进程，运行队列为空时返回NULL
+static Process *CFS_leftmost(RunQueue *rq) {
+    rbtree_node_t *root = rbtree_root(&(rq->run_tree));
+    rbtree_node_t *sentinel = rbtree_sentinel(&(rq->run_tree));
+    if (root == sentinel) {
+        return NULL;
+    }
+    return node2process(rbtree_min(root, sentinel));
+}
+
+// min_vruntime只增不减，取正在运行的进程和队列中最左进程的较小者
+static void CFS_update_min_vruntime(RunQueue *rq, Process *running) {
+    uint64_t vruntime = rq->min_vruntime;
+    Process *leftmost = CFS_leftmost(rq);
+    if (running != NULL) {
+        vruntime = running->vruntime;
+        if (leftmost != NULL && leftmost->vruntime < vruntime) {
+            vruntime = leftmost->vruntime;
+        }
+    } else if (leftmost != NULL) {
+        vruntime = leftmost->vruntime;
+    }
+    if (vruntime > rq->min_vruntime) {
+        rq->min_vruntime = vruntime;
+    }
+}
+
+static void CFS_init(RunQueue *rq) {
+    list_init(&(rq->run_list));
+    rbtree_init(&(rq->run_tree), CFS_compare);
+    rq->process_count = 0;
+    rq->min_vruntime = 0;
+    rq->total_weight = 0;
+}
+
+static void CFS_enqueue(RunQueue *rq, Process *process) {
+    if (process->rq == NULL) {
+        // 新创建的进程从min_vruntime开始
+        process->vruntime = rq->min_vruntime;
+    } else {
+        if (process->rq != rq) {
+            // 从其他cpu迁移过来，vruntime换算成相对本队列min_vruntime的值
+            process->vruntime = process->vruntime - process->rq->min_vruntime + rq->min_vruntime;
+        }
+        if (process->vruntime + SCHED_SLEEPER_BONUS < rq->min_vruntime) {
+            process->vruntime = rq->min_vruntime - SCHED_SLEEPER_BONUS;
+        }
+    }
+    rbtree_insert(&(rq->run_tree), &(process->run_node));
+    process->rq = rq;
+    rq->process_count++;
+    rq->total_weight += process_weight(process);
+}
+
+static void CFS_dequeue(RunQueue *rq, Process *process) {
+    assert(process->rq == rq && rq->process_count > 0);
+    rbtree_delete(&(rq->run_tree), &(process->run_node));
+    rq->process_count--;
+    rq->total_weight -= process_weight(process);
+    CFS_update_min_vruntime(rq, process);
+
+    // 被选中运行的进程按权重分得调度周期中的一段时间
+    unsigned int weight = process_weight(process);
+    unsigned int slice = SCHED_LATENCY * weight / (rq->total_weight + weight);
+    process->time_slice = slice < SCHED_MIN_GRANULARITY ? SCHED_MIN_GRANULARITY : slice;
+}
+
+// 红黑树最左节点即vruntime最小的进程，O(log n)
+static Process *CFS_pick_next(RunQueue *rq) {
+    return CFS_leftmost(rq);
+}
+
+static void CFS_process_tick(RunQueue *rq, Process *process) {
+    process->vruntime += TICK_NS * NICE_0_WEIGHT / process_weight(process);
+    CFS_update_min_vruntime(rq, process);
+    if (process->time_slice > 0) {
+        process->time_slice--;
+    }
+    if (process->time_slice == 0) {
+        process->need_resched = 1;
+    }
+}
+
+static ScheduleClass CFS_schedule_class = {
+    .name = "CFS_scheduler",
+    .init = CFS_init,
+    .enqueue = CFS_enqueue,
+    .dequeue = CFS_dequeue,
+    .pick_next = CFS_pick_next,
+    .process_tick = CFS_process_tick,
+};
+
+ScheduleClass *get_CFS_schedule_class(void) {
+    return &CFS_schedule_class;
+}
@@ -0,0 +1,9 @@
+#ifndef __KERNEL_SCHEDULE_SCHEDULE_CFS_H__
+#define __KERNEL_SCHEDULE_SCHEDULE_CFS_H__
+
+#include <schedule.h>
+
+ScheduleClass *get_CFS_schedule_class(void);
+
+
+#endif // __KERNEL_SCHEDULE_SCHEDULE_CFS_H__
@@ -2,13 +2,21 @@
 #include <assert.h>
 #include <process.h>
 #include <types.h>
+#include <clock.h>
 #include <schedule_RR.h>
 #include <schedule_MLFQ.h>
 
 static ScheduleClass *schedule_class;
 
+// 优先级提升的轮次，按系统时间计算，所有cpu共用。
+// 错过了提升的进程(睡眠、阻塞或者在停止了时钟的cpu上)在下次入队时比较轮次补上
+static inline unsigned int MLFQ_boost_epoch(void) {
+    return get_ticks() / MLFQ_BOOST_INTERVAL;
+}
+
 static void MLFQ_init(RunQueue *rq) {
     schedule_class = get_RR_schedule_class();
+    rq->boost_epoch = 0;
     ListEntry *head = &(rq->rq_link);
     ListEntry *entry = head;
     do {
@@ -17,21 +25,51 @@ static void MLFQ_init(RunQueue *rq) {
     } while (entry != head);
 }
 
+// 进程可能是从其他cpu迁移过来的，process->rq属于其他cpu的队列环，
+// 按时间片大小在rq所在的队列环中找到同一级的队列
+static RunQueue *MLFQ_same_level(RunQueue *rq, RunQueue *process_rq) {
+    ListEntry *head = &(rq->rq_link);
+    ListEntry *entry = head;
+    do {
+        RunQueue *level = le2runqueue(entry, rq_link);
+        if (level == process_rq || level->max_time_slice == process_rq->max_time_slice) {
+            return level;
+        }
+        entry = list_next(entry);
+    } while (entry != head);
+    return rq;
+}
+
+// 进程在一级队列中可以累计运行的tick数
+static inline int MLFQ_allotment(RunQueue *level) {
+    return level->max_time_slice * MLFQ_ALLOTMENT_SLICES;
+}
+
 static void MLFQ_enqueue(RunQueue *rq, Process *process) {
     assert(list_empty(&(process->run_link)));
     RunQueue *next_rq = rq;
-    // 进程的时间片用完了，但是还没有完成任务，需要继续放入队列（放入下一个时间片更大的队列中）
-    if (process->rq != NULL && process->time_slice == 0) {
-        next_rq = le2runqueue(list_next(&(process->rq->rq_link)), rq_link);
-        if (next_rq == rq) {
+    unsigned int epoch = MLFQ_boost_epoch();
+    // 新进程和上次入队之后经过了优先级提升的进程放入最高级队列，其余进程留在原来的级别，
+    // 在该级别用完配额后放入下一个时间片更大的队列中
+    if (process->rq != NULL && process->boost_epoch != epoch) {
+        process->allotment_used = 0;
+        process->time_slice = 0;
+    } else if (process->rq != NULL) {
+        next_rq = MLFQ_same_level(rq, process->rq);
+        if (process->allotment_used >= MLFQ_allotment(next_rq)) {
+            RunQueue *lower_rq = le2runqueue(list_next(&(next_rq->rq_link)), rq_link);
             // 如果下一个队列的时间片比当前队列时间片小的话，则还是放入当前队列
-            next_rq = process->rq;
+            if (lower_rq != rq) {
+                next_rq = lower_rq;
+                process->time_slice = 0;
+            }
+            process->allotment_used = 0;
         }
     }
+    process->boost_epoch = epoch;
     schedule_class->enqueue(next_rq, process);
 }
 
-
 static void MLFQ_dequeue(RunQueue *rq, Process *process) {
     assert(!list_empty(&process->run_link));
     schedule_class->dequeue(process->rq, process);
@@ -51,8 +89,34 @@ static Process *MLFQ_pick_next(RunQueue *rq) {
     return next;
 }
 
+// 把低级队列中的进程都移到最高级队列rq中，正在运行的进程下次入队时也回到最高级
+static void MLFQ_boost(RunQueue *rq, Process *running, unsigned int epoch) {
+    ListEntry *entry = list_next(&(rq->rq_link));
+    while (entry != &(rq->rq_link)) {
+        RunQueue *level = le2runqueue(entry, rq_link);
+        Process *process;
+        while ((process = schedule_class->pick_next(level)) != NULL) {
+            schedule_class->dequeue(level, process);
+            process->allotment_used = 0;
+            process->time_slice = 0;
+            process->boost_epoch = epoch;
+            schedule_class->enqueue(rq, process);
+        }
+        entry = list_next(entry);
+    }
+    running->allotment_used = 0;
+    running->rq = rq;
+    running->boost_epoch = epoch;
+    rq->boost_epoch = epoch;
+}
+
 static void MLFQ_process_tick(RunQueue *rq, Process *process) {
+    process->allotment_used++;
     schedule_class->process_tick(process->rq, process);
+    unsigned int epoch = MLFQ_boost_epoch();
+    if (rq->boost_epoch != epoch) {
+        MLFQ_boost(rq, process, epoch);
+    }
 }
 
 ScheduleClass MLFQ_schedule_class = {
@@ -3,6 +3,17 @@
 
 #include <schedule.h>
 
+// 系统时间每经过MLFQ_BOOST_INTERVAL个tick，把所有进程提升到最高优先级的队列，防止饿死
+#ifndef MLFQ_BOOST_INTERVAL
+#define MLFQ_BOOST_INTERVAL     1000
+#endif
+
+// 进程在一级队列中累计运行MLFQ_ALLOTMENT_SLICES个该级时间片后降级，
+// 累计值不会因为主动让出cpu而清零，防止进程在时间片用完前yield来一直占据高优先级
+#ifndef MLFQ_ALLOTMENT_SLICES
+#define MLFQ_ALLOTMENT_SLICES   2
+#endif
+
 ScheduleClass *get_MLFQ_schedule_class(void);
 
 
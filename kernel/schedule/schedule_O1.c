@@ -0,0 +1,114 @@
+#include <schedule_O1.h>
+#include <list.h>
+#include <assert.h>
+#include <process.h>
+#include <types.h>
+#include <x86.h>
+
+// O(1)调度：每个运行队列有active和expired两个优先级数组，
+// 每个数组有PRIO_LEVELS个链表和一个表示非空链表的bitmap，
+// 入队、出队只操作一个链表和bitmap的一位，选择进程用bsf找到最高优先级的非空链表。
+// 时间片用完的进程放入expired，active为空时交换两个数组，低优先级的进程不会饿死。
+
+// nice值映射为优先级[0, PRIO_LEVELS)
+static inline int process_prio(Process *process) {
+    return (process->nice - NICE_MIN) * PRIO_LEVELS / (NICE_MAX - NICE_MIN + 1);
+}
+
+// 优先级越高时间片越长：prio 0为PRIO_LEVELS个tick，最低优先级为1个tick
+static inline int prio_time_slice(int prio) {
+    return PRIO_LEVELS - prio;
+}
+
+static void prio_array_init(PrioArray *array) {
+    int i;
+    array->bitmap = 0;
+    array->nr_active = 0;
+    for (i = 0; i < PRIO_LEVELS; i++) {
+        list_init(&(array->queue[i]));
+    }
+}
+
+static void prio_array_enqueue(PrioArray *array, Process *process) {
+    int prio = process_prio(process);
+    list_add_before(&(array->queue[prio]), &(process->run_link));
+    array->bitmap |= (1 << prio);
+    array->nr_active++;
+    process->array = array;
+}
+
+static void prio_array_dequeue(PrioArray *array, Process *process) {
+    int prio = process_prio(process);
+    list_del_init(&(process->run_link));
+    if (list_empty(&(array->queue[prio]))) {
+        array->bitmap &= ~(1 << prio);
+    }
+    array->nr_active--;
+    process->array = NULL;
+}
+
+static void O1_init(RunQueue *rq) {
+    list_init(&(rq->run_list));
+    rq->process_count = 0;
+    prio_array_init(&(rq->arrays[0]));
+    prio_array_init(&(rq->arrays[1]));
+    rq->active = &(rq->arrays[0]);
+    rq->expired = &(rq->arrays[1]);
+}
+
+static void O1_enqueue(RunQueue *rq, Process *process) {
+    assert(list_empty(&(process->run_link)) && process->array == NULL);
+    PrioArray *array = rq->active;
+    int prio = process_prio(process);
+    if (process->time_slice == 0 || process->time_slice > prio_time_slice(prio)) {
+        // 新进程和从其他cpu迁移过来的进程直接放入active，其余用完时间片的进程等到下一轮
+        if (process->rq == rq && process->time_slice == 0) {
+            array = rq->expired;
+        }
+        process->time_slice = prio_time_slice(prio);
+    }
+    prio_array_enqueue(array, process);
+    process->rq = rq;
+    rq->process_count++;
+}
+
+static void O1_dequeue(RunQueue *rq, Process *process) {
+    assert(process->rq == rq && process->array != NULL);
+    prio_array_dequeue(process->array, process);
+    rq->process_count--;
+}
+
+static Process *O1_pick_next(RunQueue *rq) {
+    if (rq->active->nr_active == 0) {
+        if (rq->expired->nr_active == 0) {
+            return NULL;
+        }
+        PrioArray *array = rq->active;
+        rq->active = rq->expired;
+        rq->expired = array;
+    }
+    int prio = bsf(rq->active->bitmap);
+    return le2process(list_next(&(rq->active->queue[prio])), run_link);
+}
+
+static void O1_process_tick(RunQueue *rq, Process *process) {
+    if (process->time_slice > 0) {
+        process->time_slice--;
+    }
+    if (process->time_slice == 0) {
+        process->need_resched = 1;
+    }
+}
+
+static ScheduleClass O1_schedule_class = {
+    .name = "O1_scheduler",
+    .init = O1_init,
+    .enqueue = O1_enqueue,
+    .dequeue = O1_dequeue,
+    .pick_next = O1_pick_next,
+    .process_tick = O1_process_tick,
+};
+
+ScheduleClass *get_O1_schedule_class(void) {
+    return &O1_schedule_class;
+}
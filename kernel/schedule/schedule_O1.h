@@ -0,0 +1,9 @@
+#ifndef __KERNEL_SCHEDULE_SCHEDULE_O1_H__
+#define __KERNEL_SCHEDULE_SCHEDULE_O1_H__
+
+#include <schedule.h>
+
+ScheduleClass *get_O1_schedule_class(void);
+
+
+#endif // __KERNEL_SCHEDULE_SCHEDULE_O1_H__
@@ -0,0 +1,211 @@
+#include <tick.h>
+#include <x86.h>
+#include <lapic.h>
+#include <clock.h>
+#include <process.h>
+#include <schedule.h>
+#include <spinlock.h>
+
+// 动态时钟：没有事情可做时不再每个tick都产生时钟中断
+// 1. idle的cpu执行hlt，ap直接关掉lapic定时器；bsp负责推进系统时间和时间轮，
+//    只有在所有cpu都空闲时，才改为在下一个定时器到期时触发的一次性定时器，醒来后补上错过的tick
+// 2. ap上只有一个进程在运行(运行队列为空)时也停止周期时钟，有新进程入队时由ipi恢复
+// 使用8253时(没有lapic)保持周期时钟，idle只执行hlt
+// 3. 高精度定时器：周期时钟模式下把当前tick拆开，先用一次性定时器在最早的到期时间产生中断，
+//    处理完再用一次性定时器补上这个tick剩下的计数，这个tick的中断到来后恢复周期时钟。
+//    cpu上有高精度定时器时不停止周期时钟；没有lapic时只能在每个tick检查一次
+
+// 高精度定时器提前这么多纳秒到期，抵消中断和调度的延迟，剩下的时间由调用者忙等，见hrtimer_calibrate
+#define HRTIMER_SLACK_MIN       2000
+#define HRTIMER_SLACK_MAX       (TICK_NS / 4)
+
+uint32_t hrtimer_slack_ns = 20000;
+
+static inline bool hrtimer_pending(Cpu *cpu) {
+    return !list_empty(&(cpu->hrtimers));
+}
+
+// 停止周期时钟前调用，丢弃拆开tick的状态
+static inline void tick_split_reset(Cpu *cpu) {
+    cpu->tick_split = 0;
+    cpu->tick_oneshot = false;
+}
+
+// 停止当前cpu的周期时钟，调用时持有大内核锁并且关中断
+static void tick_stop(Cpu *cpu) {
+    if (lapic == NULL || hrtimer_pending(cpu)) {
+        return;
+    }
+    if (cpu->id != 0) {
+        tick_split_reset(cpu);
+        lapic_timer_stop();
+        cpu->tick_stopped = true;
+        return;
+    }
+
+    int i;
+    for (i = 1; i < ncpu; i++) {
+        if (cpus[i].started && cpus[i].curr != cpus[i].idle) {
+            // 还有cpu在运行进程，bsp需要继续推进系统时间
+            return;
+        }
+    }
+    uint32_t next = next_timer_ticks();
+    if (next == 0 || next > lapic_timer_max_ticks()) {
+        next = lapic_timer_max_ticks();
+    }
+    if (next > 1) {
+        tick_split_reset(cpu);
+        lapic_timer_oneshot(next);
+        cpu->tick_stopped = true;
+    }
+}
+
+// 恢复周期时钟，bsp补上一次性定时期间经过的tick
+void tick_restart(Cpu *cpu) {
+    if (!cpu->tick_stopped) {
+        return;
+    }
+    cpu->tick_stopped = false;
+    if (cpu->id == 0) {
+        uint32_t elapsed = lapic_timer_elapsed();
+        set_ticks(get_ticks() + elapsed);
+        run_timer_ticks(elapsed);
+    }
+    lapic_timer_periodic();
+}
+
+// idle进程调用，不持有大内核锁，hlt直到下一个中断
+void tick_idle(void) {
+    Cpu *cpu = this_cpu();
+    lock_kernel();
+    // 关中断后再检查need_resched，之后到来的ipi会在sti_hlt之后才响应，不会丢失唤醒
+    cli();
+    if (current->need_resched) {
+        unlock_kernel();
+        sti();
+        return;
+    }
+    tick_stop(cpu);
+    unlock_kernel();
+    sti_hlt();
+
+    if (cpu->tick_stopped) {
+        lock_kernel();
+        tick_restart(cpu);
+        unlock_kernel();
+    }
+}
+
+// 时钟中断中调用：ap的运行队列为空时，正在运行的进程不需要被抢占，停止周期时钟
+void tick_nohz_busy(void) {
+    Cpu *cpu = this_cpu();
+    if (lapic != NULL && cpu->id != 0 && current != cpu->idle && cpu->nr_running == 0 &&
+        !hrtimer_pending(cpu)) {
+        tick_split_reset(cpu);
+        lapic_timer_stop();
+        cpu->tick_stopped = true;
+    }
+}
+
+// 其他cpu向本cpu的运行队列加入了进程，idle会在tick_idle中恢复时钟，
+// 正在运行的进程则需要恢复时钟并重新调度
+void tick_resched_ipi(void) {
+    Cpu *cpu = this_cpu();
+    if (cpu->tick_stopped && current != cpu->idle) {
+        tick_restart(cpu);
+        current->need_resched = true;
+    }
+}
+
+// 如果最早的高精度定时器在当前tick结束之前到期，把当前tick拆开，用一次性定时器在到期时产生中断；
+// 否则等到tick中断时再处理。调用时持有大内核锁并且关中断
+static void hrtimer_program(Cpu *cpu) {
+    if (lapic == NULL || cpu->tick_stopped || !hrtimer_pending(cpu)) {
+        return;
+    }
+    HrTimer *first = le2hrtimer(list_next(&(cpu->hrtimers)), hrtimer_link);
+    uint64_t now = get_clock_ns();
+    uint32_t count = (first->expires > now) ? lapic_timer_ns_to_count(first->expires - now) : 0;
+    uint32_t remain = lapic_timer_remain() + cpu->tick_split;
+    if (count >= remain) {
+        return;
+    }
+    lapic_timer_oneshot_count(count);
+    cpu->tick_split = remain - count;
+}
+
+// 唤醒当前cpu上已经到期的高精度定时器的进程
+static void run_hrtimers(Cpu *cpu) {
+    uint64_t now = get_clock_ns();
+    while (hrtimer_pending(cpu)) {
+        HrTimer *timer = le2hrtimer(list_next(&(cpu->hrtimers)), hrtimer_link);
+        if (timer->expires > now) {
+            break;
+        }
+        list_del_init(&(timer->hrtimer_link));
+        // 进程可能已经被kill唤醒，还没来得及取消定时器
+        if (timer->process->state != STATE_RUNNABLE) {
+            wakeup_process(timer->process);
+        }
+    }
+}
+
+// 在当前cpu上启动高精度定时器，调用者随后睡眠，到期时被唤醒
+void hrtimer_start(HrTimer *timer) {
+    bool flag;
+    Cpu *cpu = this_cpu();
+    local_intr_save(flag);
+    {
+        assert(list_empty(&(timer->hrtimer_link)));
+        ListEntry *entry = &(cpu->hrtimers);
+        while ((entry = list_next(entry)) != &(cpu->hrtimers)) {
+            if (le2hrtimer(entry, hrtimer_link)->expires > timer->expires) {
+                break;
+            }
+        }
+        list_add_before(entry, &(timer->hrtimer_link));
+        // 只运行一个进程的ap可能停止了周期时钟
+        tick_restart(cpu);
+        hrtimer_program(cpu);
+    }
+    local_intr_restore(flag);
+}
+
+// 定时器到期前被唤醒(比如被kill)时取消；已经拆开的tick照常在中断中补上
+void hrtimer_cancel(HrTimer *timer) {
+    bool flag;
+    local_intr_save(flag);
+    {
+        list_del_init(&(timer->hrtimer_link));
+    }
+    local_intr_restore(flag);
+}
+
+// 时钟中断中调用，返回true表示这次中断是拆开tick产生的，不是一个完整的tick
+bool hrtimer_interrupt(void) {
+    Cpu *cpu = this_cpu();
+    bool split = (cpu->tick_split != 0);
+    if (split) {
+        // 接着产生这个tick剩下的部分
+        lapic_timer_oneshot_count(cpu->tick_split);
+        cpu->tick_split = 0;
+        cpu->tick_oneshot = true;
+    } else if (cpu->tick_oneshot) {
+        cpu->tick_oneshot = false;
+        lapic_timer_periodic();
+    }
+    run_hrtimers(cpu);
+    hrtimer_program(cpu);
+    return split;
+}
+
+// 根据进程从定时器到期到实际运行的延迟调整提前量，取最近几次的滑动平均
+void hrtimer_calibrate(uint64_t latency) {
+    uint32_t slack = (latency > HRTIMER_SLACK_MAX) ? HRTIMER_SLACK_MAX : (uint32_t)latency;
+    slack = (hrtimer_slack_ns * 7 + slack) / 8;
+    if (slack < HRTIMER_SLACK_MIN) {
+        slack = HRTIMER_SLACK_MIN;
+    }
+    hrtimer_slack_ns = slack;
+}
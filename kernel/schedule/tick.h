@@ -0,0 +1,38 @@
+#ifndef __KERNEL_SCHEDULE_TICK_H__
+#define __KERNEL_SCHEDULE_TICK_H__
+
+#include <types.h>
+#include <list.h>
+#include <cpu.h>
+
+struct process_struct;
+
+// 高精度定时器，到期时间是get_clock_ns的纳秒数，挂在启动它的cpu上
+typedef struct hrtimer {
+    uint64_t expires;
+    struct process_struct *process;
+    ListEntry hrtimer_link;
+} HrTimer;
+
+#define le2hrtimer(le, member)      \
+    container_of((le), HrTimer, member)
+
+static inline HrTimer *hrtimer_init(HrTimer *timer, struct process_struct *process, uint64_t expires) {
+    timer->expires = expires;
+    timer->process = process;
+    list_init(&(timer->hrtimer_link));
+    return timer;
+}
+
+extern uint32_t hrtimer_slack_ns;
+
+void tick_idle(void);
+void tick_restart(Cpu *cpu);
+void tick_nohz_busy(void);
+void tick_resched_ipi(void);
+void hrtimer_start(HrTimer *timer);
+void hrtimer_cancel(HrTimer *timer);
+bool hrtimer_interrupt(void);
+void hrtimer_calibrate(uint64_t latency);
+
+#endif // __KERNEL_SCHEDULE_TICK_H__
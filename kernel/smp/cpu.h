@@ -0,0 +1,49 @@
+#ifndef __KERNEL_SMP_CPU_H__
+#define __KERNEL_SMP_CPU_H__
+
+#include <types.h>
+#include <mmu.h>
+#include <list.h>
+#include <lapic.h>
+
+#define NCPU        8
+
+struct process_struct;
+struct run_queue;
+
+typedef struct cpu_struct {
+    int id;                             // cpu在cpus数组中的下标，bsp的id为0
+    uint8_t apic_id;                    // local apic id
+    volatile bool started;              // ap是否已经启动完成
+    struct process_struct *curr;        // 当前cpu上运行的进程
+    struct process_struct *idle;        // 当前cpu的idle进程
+    struct run_queue *rq;               // 当前cpu的运行队列
+    unsigned int nr_running;            // 运行队列中的进程数(不包括正在运行的进程)
+    unsigned int nr_migrations;         // 从其他cpu迁移(偷)过来的进程数
+    bool tick_stopped;                  // 周期时钟中断是否已经停止(见tick.c)
+    ListEntry hrtimers;                 // 当前cpu上的高精度定时器，按到期时间排序
+    uint32_t tick_split;                // 当前tick被高精度定时器拆开后剩下的lapic计数
+    bool tick_oneshot;                  // 当前tick剩下的部分由一次性定时器产生，之后恢复周期时钟
+    uintptr_t page_dir;                 // cr3中加载的页目录，内核线程沿用上一个进程的页目录(lazy mm)
+    struct process_struct *fpu_owner;   // fpu寄存器中保存的是哪个进程的状态(见fpu.c)
+    struct TaskState ts;                // 每个cpu都有自己的tss，用于中断时切换到内核栈
+} Cpu;
+
+extern Cpu cpus[NCPU];
+extern int ncpu;
+extern uint8_t apic_to_cpu[256];
+
+static inline Cpu *this_cpu(void) {
+    if (lapic == NULL) {
+        return &cpus[0];
+    }
+    return &cpus[apic_to_cpu[lapic_id()]];
+}
+
+void mp_init(void);
+void mp_boot_ap(void);
+void tlb_shootdown(uintptr_t page_dir);
+void page_dir_drop(uintptr_t page_dir);
+void tlb_shootdown_handler(void);
+
+#endif // __KERNEL_SMP_CPU_H__
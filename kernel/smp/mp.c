@@ -0,0 +1,386 @@
+#include <types.h>
+#include <x86.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <memlayout.h>
+#include <mmu.h>
+#include <pmm.h>
+#include <trap.h>
+#include <intr.h>
+#include <clock.h>
+#include <lapic.h>
+#include <ioapic.h>
+#include <pic_irq.h>
+#include <process.h>
+#include <spinlock.h>
+#include <cpu.h>
+#include <fpu.h>
+
+// Multiprocessor Specification Version 1.4
+// bios在内存中留下了MP表，通过它可以找到所有的处理器以及lapic、ioapic的地址
+
+// floating pointer [MP 4.1]
+typedef struct {
+    uint8_t signature[4];       // "_MP_"
+    uint32_t phys_addr;         // phys addr of MP config table
+    uint8_t length;             // 1
+    uint8_t spec_rev;           // [14]
+    uint8_t checksum;           // all bytes must add up to 0
+    uint8_t type;               // MP system config type
+    uint8_t imcrp;
+    uint8_t reserved[3];
+} __attribute__((packed)) MpFloatPointer;
+
+// configuration table header [MP 4.2]
+typedef struct {
+    uint8_t signature[4];       // "PCMP"
+    uint16_t length;            // total table length
+    uint8_t version;            // [14]
+    uint8_t checksum;           // all bytes must add up to 0
+    uint8_t product[20];        // product id
+    uint32_t oem_table;         // OEM table pointer
+    uint16_t oem_length;        // OEM table length
+    uint16_t entry;             // entry count
+    uint32_t lapic_addr;        // address of local APIC
+    uint16_t xlength;           // extended table length
+    uint8_t xchecksum;          // extended table checksum
+    uint8_t reserved;
+    uint8_t entries[0];         // table entries
+} __attribute__((packed)) MpConfig;
+
+// processor table entry [MP 4.3.1]
+typedef struct {
+    uint8_t type;               // entry type (0)
+    uint8_t apic_id;            // local APIC id
+    uint8_t version;            // local APIC version
+    uint8_t flags;              // CPU flags
+    uint8_t signature[4];       // CPU signature
+    uint32_t feature;           // feature flags from CPUID instruction
+    uint8_t reserved[8];
+} __attribute__((packed)) MpProcessor;
+
+// I/O APIC table entry [MP 4.3.3]
+typedef struct {
+    uint8_t type;               // entry type (2)
+    uint8_t apic_id;            // I/O APIC id
+    uint8_t version;            // I/O APIC version
+    uint8_t flags;              // I/O APIC flags
+    uint32_t addr;              // I/O APIC address
+} __attribute__((packed)) MpIoApic;
+
+// MpProcessor flags
+#define MPPROC_BOOT     0x02    // This processor is the bootstrap processor
+
+// Table entry types
+#define MPPROC          0x00    // One per processor
+#define MPBUS           0x01    // One per bus
+#define MPIOAPIC        0x02    // One per I/O APIC
+#define MPIOINTR        0x03    // One per bus interrupt source
+#define MPLINTR         0x04    // One per system interrupt source
+
+#define IOAPIC_SIZE     0x20
+#define LAPIC_SIZE      0x400
+
+Cpu cpus[NCPU];
+int ncpu = 1;
+uint8_t apic_to_cpu[256];
+
+spinlock_t kernel_lock = {0, -1};
+
+// mpentry.S中ap使用的内核栈
+void *mpentry_kstack;
+
+// 需要刷新tlb的cpu位图，由发起tlb shootdown的cpu设置，目标cpu刷新后清除自己的位
+static volatile uint32_t tlb_shootdown_pending;
+// 非0时表示这个页目录将要被释放，目标cpu改为加载boot页目录
+static volatile uintptr_t tlb_shootdown_drop;
+
+// MP表在低于1M的物理内存中，或者在bios保留的高端内存中，都在内核直接映射的范围内
+static inline void *mp_kva(uintptr_t pa) {
+    assert(pa + KERNEL_BASE < KERNEL_TOP);
+    return (void *)(pa + KERNEL_BASE);
+}
+
+static uint8_t sum(void *addr, int len) {
+    int i, sum = 0;
+    for (i = 0; i < len; i++) {
+        sum += ((uint8_t *)addr)[i];
+    }
+    return sum;
+}
+
+// Look for an MP structure in the len bytes at physical address addr.
+static MpFloatPointer *mp_search_sub(uintptr_t pa, int len) {
+    MpFloatPointer *mp = mp_kva(pa), *end = mp_kva(pa + len);
+    for (; mp < end; mp++) {
+        if (memcmp(mp->signature, "_MP_", 4) == 0 &&
+                sum(mp, sizeof(*mp)) == 0) {
+            return mp;
+        }
+    }
+    return NULL;
+}
+
+// Search for the MP Floating Pointer Structure, which according to
+// [MP 4] is in one of the following three locations:
+// 1) in the first KB of the EBDA;
+// 2) if there is no EBDA, in the last KB of system base memory;
+// 3) in the BIOS ROM between 0xE0000 and 0xFFFFF.
+static MpFloatPointer *mp_search(void) {
+    uint8_t *bda = mp_kva(0x400);
+    uint32_t p;
+    MpFloatPointer *mp;
+
+    // The 16-bit segment of the EBDA is in the two bytes
+    // starting at byte 0x0E of the BDA.  0 if not present.
+    if ((p = *(uint16_t *)(bda + 0x0E))) {
+        p <<= 4;    // Translate from segment to PA
+        if ((mp = mp_search_sub(p, 1024))) {
+            return mp;
+        }
+    } else {
+        // The size of base memory, in KB is in the two bytes
+        // starting at 0x13 of the BDA.
+        p = *(uint16_t *)(bda + 0x13) * 1024;
+        if ((mp = mp_search_sub(p - 1024, 1024))) {
+            return mp;
+        }
+    }
+    return mp_search_sub(0xF0000, 0x10000);
+}
+
+// Search for an MP configuration table.  For now, don't accept the
+// default configurations (phys_addr == 0).
+// Check for the correct signature, checksum, and version.
+static MpConfig *mp_config(MpFloatPointer **pmp) {
+    MpConfig *conf;
+    MpFloatPointer *mp;
+
+    if ((mp = mp_search()) == NULL) {
+        return NULL;
+    }
+    if (mp->phys_addr == 0 || mp->type != 0) {
+        printk("SMP: Default configurations not implemented\n");
+        return NULL;
+    }
+    conf = mp_kva(mp->phys_addr);
+    if (memcmp(conf, "PCMP", 4) != 0) {
+        printk("SMP: Incorrect MP configuration table signature\n");
+        return NULL;
+    }
+    if (sum(conf, conf->length) != 0) {
+        printk("SMP: Bad MP configuration checksum\n");
+        return NULL;
+    }
+    if (conf->version != 1 && conf->version != 4) {
+        printk("SMP: Unsupported MP version %d\n", conf->version);
+        return NULL;
+    }
+    if ((sum((uint8_t *)conf + conf->length, conf->xlength) + conf->xchecksum) & 0xFF) {
+        printk("SMP: Bad MP configuration extended checksum\n");
+        return NULL;
+    }
+    *pmp = mp;
+    return conf;
+}
+
+// 解析MP表，找到所有的cpu以及lapic、ioapic的地址，bsp总是放在cpus[0]
+// 没有MP表时退化为单处理器，继续使用8259A和8253
+void mp_init(void) {
+    MpFloatPointer *mp;
+    MpConfig *conf;
+    MpProcessor *proc;
+    MpIoApic *mp_ioapic;
+    uint8_t *p;
+    uintptr_t ioapic_pa = 0;
+    int i, nproc = 0, bsp = 0;
+    bool ismp = true;
+
+    cpus[0].id = 0;
+    cpus[0].started = true;
+    cpus[0].page_dir = (uintptr_t)get_boot_page_dir();
+
+    if ((conf = mp_config(&mp)) == NULL) {
+        printk("SMP: no MP table found, running on one cpu.\n");
+        return;
+    }
+
+    for (p = conf->entries, i = 0; i < conf->entry; i++) {
+        switch (*p) {
+            case MPPROC:
+                proc = (MpProcessor *)p;
+                if (nproc < NCPU) {
+                    if (proc->flags & MPPROC_BOOT) {
+                        bsp = nproc;
+                    }
+                    cpus[nproc].apic_id = proc->apic_id;
+                    nproc++;
+                } else {
+                    printk("SMP: too many CPUs, CPU %d disabled\n", proc->apic_id);
+                }
+                p += sizeof(MpProcessor);
+                continue;
+            case MPIOAPIC:
+                mp_ioapic = (MpIoApic *)p;
+                ioapic_id = mp_ioapic->apic_id;
+                ioapic_pa = mp_ioapic->addr;
+                p += sizeof(MpIoApic);
+                continue;
+            case MPBUS:
+            case MPIOINTR:
+            case MPLINTR:
+                p += 8;
+                continue;
+            default:
+                printk("SMP: unknown config type %x\n", *p);
+                ismp = false;
+                i = conf->entry;
+        }
+    }
+
+    if (!ismp || nproc == 0 || ioapic_pa == 0) {
+        printk("SMP: bad MP table, running on one cpu.\n");
+        cpus[0].apic_id = 0;
+        return;
+    }
+
+    // 将bsp交换到cpus[0]
+    if (bsp != 0) {
+        uint8_t apic_id = cpus[0].apic_id;
+        cpus[0].apic_id = cpus[bsp].apic_id;
+        cpus[bsp].apic_id = apic_id;
+    }
+    ncpu = nproc;
+    for (i = 0; i < ncpu; i++) {
+        cpus[i].id = i;
+        apic_to_cpu[cpus[i].apic_id] = i;
+    }
+
+    if (mp->imcrp) {
+        // [MP 3.2.6.1] If the hardware implements PIC mode,
+        // switch to getting interrupts from the LAPIC.
+        printk("SMP: Setting IMCR to switch from PIC mode to symmetric I/O mode\n");
+        outb(0x22, 0x70);           // Select IMCR
+        outb(0x23, inb(0x23) | 1);  // Mask external interrupts.
+    }
+
+    lapic = mmio_map(conf->lapic_addr, LAPIC_SIZE);
+    ioapic = mmio_map(ioapic_pa, IOAPIC_SIZE);
+    assert(lapic_id() == cpus[0].apic_id);
+
+    lapic_init();
+    ioapic_init();
+    // 外设中断由ioapic统一发送给bsp
+    pic_route_to_ioapic(cpus[0].apic_id);
+
+    printk("SMP: CPU %d found %d CPU(s)\n", cpus[0].apic_id, ncpu);
+}
+
+// ap从mpentry.S跳转到这里
+void mp_main(void) {
+    Cpu *cpu = this_cpu();
+
+    lapic_init();
+    gdt_init();
+    load_esp0((uintptr_t)mpentry_kstack);
+    idt_load();
+    fpu_init();
+
+    cpu->curr = cpu->idle;
+    cpu->page_dir = (uintptr_t)get_boot_page_dir();
+    // 通知bsp启动下一个ap
+    cpu->started = true;
+
+    lock_kernel();
+    printk("SMP: CPU %d (apic %d) started.\n", cpu->id, cpu->apic_id);
+
+    intr_enable();
+    cpu_idle();
+}
+
+// 在所有idle进程创建好之后、第一个用户进程创建之前调用
+void mp_boot_ap(void) {
+    extern unsigned char mpentry_start[], mpentry_end[];
+    pde_t *page_dir = get_boot_page_dir();
+    int i, j;
+
+    if (ncpu == 1) {
+        return;
+    }
+
+    // Write entry code to unused memory at MPENTRY_PADDR
+    memmove(mp_kva(MPENTRY_PADDR), mpentry_start, mpentry_end - mpentry_start);
+
+    // ap开启分页时eip还在低地址，临时建立[0, 4M)的恒等映射
+    assert(page_dir[0] == 0);
+    // 不能带全局位，否则拆除映射之后tlb中还会留着这一项
+    page_dir[0] = page_dir[PDX(KERNEL_BASE)] & ~PTE_G;
+
+    for (i = 1; i < ncpu; i++) {
+        Cpu *cpu = &cpus[i];
+        mpentry_kstack = (void *)(cpu->idle->kstack + K_STACK_SIZE);
+        lapic_start_ap(cpu->apic_id, MPENTRY_PADDR);
+        // 最多等待1s
+        for (j = 0; j < 1000 && !cpu->started; j++) {
+            pit_udelay(1000);
+        }
+        if (!cpu->started) {
+            printk("SMP: CPU %d (apic %d) failed to start.\n", i, cpu->apic_id);
+        }
+    }
+
+    page_dir[0] = 0;
+    lcr3(rcr3());
+}
+
+// 持有大内核锁时调用，让其他加载了page_dir的cpu刷新tlb，并等待它们完成。
+// 内核线程会沿用上一个进程的页目录，因此按cpu->page_dir而不是当前进程的页目录判断
+static void __tlb_shootdown(uintptr_t page_dir, bool drop) {
+    Cpu *cpu = this_cpu();
+    uint32_t mask = 0;
+    int i;
+
+    if (ncpu == 1) {
+        return;
+    }
+    for (i = 0; i < ncpu; i++) {
+        if (&cpus[i] != cpu && cpus[i].started && cpus[i].page_dir == page_dir) {
+            mask |= (1 << i);
+        }
+    }
+    if (mask == 0) {
+        return;
+    }
+
+    tlb_shootdown_drop = drop ? page_dir : 0;
+    tlb_shootdown_pending = mask;
+    for (i = 0; i < ncpu; i++) {
+        if (mask & (1 << i)) {
+            lapic_send_ipi(cpus[i].apic_id, T_IPI_TLB);
+        }
+    }
+    while (tlb_shootdown_pending != 0) {
+        pause();
+    }
+}
+
+void tlb_shootdown(uintptr_t page_dir) {
+    __tlb_shootdown(page_dir, false);
+}
+
+// 页目录被释放前调用，还在沿用它的cpu(运行着内核线程)切换到boot页目录
+void page_dir_drop(uintptr_t page_dir) {
+    __tlb_shootdown(page_dir, true);
+}
+
+void tlb_shootdown_handler(void) {
+    Cpu *cpu = this_cpu();
+    if (tlb_shootdown_drop != 0 && cpu->page_dir == tlb_shootdown_drop) {
+        cpu->page_dir = (uintptr_t)get_boot_page_dir();
+        lcr3(PADDR(get_boot_page_dir()));
+    } else {
+        lcr3(rcr3());
+    }
+    clear_bit(this_cpu()->id, &tlb_shootdown_pending);
+}
@@ -0,0 +1,59 @@
+#ifndef __KERNEL_SYNC_SPINLOCK_H__
+#define __KERNEL_SYNC_SPINLOCK_H__
+
+#include <types.h>
+#include <x86.h>
+#include <assert.h>
+#include <cpu.h>
+
+// 多处理器下的自旋锁，local_intr_save只能屏蔽本cpu的中断，
+// 不能阻止其他cpu同时访问共享数据
+typedef struct {
+    volatile uint32_t locked;
+    int cpu;                    // 持有锁的cpu id，没有被持有时为-1
+} spinlock_t;
+
+static inline void spinlock_init(spinlock_t *lock) {
+    lock->locked = 0;
+    lock->cpu = -1;
+}
+
+static inline bool spin_holding(spinlock_t *lock) {
+    return lock->locked && lock->cpu == this_cpu()->id;
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+    if (spin_holding(lock)) {
+        panic("spin_lock: cpu %d already holding the lock.\n", lock->cpu);
+    }
+    while (xchg(&(lock->locked), 1) != 0) {
+        pause();
+    }
+    lock->cpu = this_cpu()->id;
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    if (!spin_holding(lock)) {
+        panic("spin_unlock: lock is not held by this cpu.\n");
+    }
+    lock->cpu = -1;
+    xchg(&(lock->locked), 0);
+}
+
+// 大内核锁：内核代码原本都是按单处理器写的(只靠关中断互斥)，
+// 因此cpu在内核中执行时必须持有kernel_lock，只有在用户态和idle等待时才释放
+extern spinlock_t kernel_lock;
+
+static inline void lock_kernel(void) {
+    spin_lock(&kernel_lock);
+}
+
+static inline void unlock_kernel(void) {
+    spin_unlock(&kernel_lock);
+}
+
+static inline bool kernel_locked(void) {
+    return spin_holding(&kernel_lock);
+}
+
+#endif // __KERNEL_SYNC_SPINLOCK_H__
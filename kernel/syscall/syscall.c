@@ -7,6 +7,8 @@
 #include <trap.h>
 #include <error.h>
 #include <sysfile.h>
+#include <time.h>
+#include <kmonitor.h>
 
 static uint32_t sys_exit(uint32_t arg[]) {
     int error_code = (int)arg[0];
@@ -44,6 +46,23 @@ static uint32_t sys_clone(uint32_t arg[]) {
     return do_fork(clone_flags, stack, tf);
 }
 
+// 父进程在子进程exec或者退出后才返回，子进程共享父进程的地址空间
+static uint32_t sys_vfork(uint32_t arg[]) {
+    struct TrapFrame *tf = current->tf;
+    uintptr_t stack = tf->tf_esp;
+    return do_fork(CLONE_VM | CLONE_VFORK, stack, tf);
+}
+
+static uint32_t sys_spawn(uint32_t arg[]) {
+    const char *path = (const char *)arg[0];
+    return do_spawn(path);
+}
+
+static uint32_t sys_exec_file(uint32_t arg[]) {
+    const char *path = (const char *)arg[0];
+    return do_execve_file(path);
+}
+
 static uint32_t sys_exit_thread(uint32_t arg[]) {
     int error_code = (int)arg[0];
     return do_exit_thread(error_code);
@@ -63,10 +82,26 @@ static uint32_t sys_gettime(uint32_t arg[]) {
     return get_ticks();
 }
 
+static uint32_t sys_clock_gettime(uint32_t arg[]) {
+    int clock_id = (int)arg[0];
+    struct timespec *ts = (struct timespec *)arg[1];
+    return do_clock_gettime(clock_id, ts);
+}
+
+static uint32_t sys_nanosleep(uint32_t arg[]) {
+    const struct timespec *req = (const struct timespec *)arg[0];
+    return do_nanosleep(req);
+}
+
 static uint32_t sys_yield(uint32_t arg[]) {
     return do_yield();
 }
 
+static uint32_t sys_nice(uint32_t arg[]) {
+    int nice = (int)arg[0];
+    return do_nice(nice);
+}
+
 static uint32_t sys_getpid(uint32_t arg[]) {
     return current->pid;
 }
@@ -82,6 +117,28 @@ static uint32_t sys_putc(uint32_t arg[]) {
     return 0;
 }
 
+static uint32_t sys_fault_around(uint32_t arg[]) {
+    int npages = (int)arg[0];
+    return set_fault_around(npages);
+}
+
+static uint32_t sys_pgfaults(uint32_t arg[]) {
+    return current->nr_page_faults;
+}
+
+static uint32_t sys_kmonitor(uint32_t arg[]) {
+    const char *cmd = (const char *)arg[0];
+    MmStruct *mm = current->mm;
+    char buf[KMONITOR_CMD_LEN + 1];
+    lock_mm(mm);
+    if (!copy_string(mm, buf, cmd, sizeof(buf))) {
+        unlock_mm(mm);
+        return -E_INVAL;
+    }
+    unlock_mm(mm);
+    return monitor_run(buf, current->tf);
+}
+
 static uint32_t sys_page_dir(uint32_t arg[]) {
     // todo:
     return 0;
@@ -223,18 +280,27 @@ static uint32_t (*syscalls[])(uint32_t arg[]) = {
     [SYS_wait] = sys_wait,
     [SYS_exec] = sys_exec,
     [SYS_clone] = sys_clone,
+    [SYS_vfork] = sys_vfork,
+    [SYS_spawn] = sys_spawn,
+    [SYS_exec_file] = sys_exec_file,
     [SYS_exit_thread] = sys_exit_thread,
     [SYS_yield] = sys_yield,
     [SYS_kill] = sys_kill,
     [SYS_getpid] = sys_getpid,
+    [SYS_nice] = sys_nice,
     [SYS_brk] = sys_brk,
     [SYS_sleep] = sys_sleep,
     [SYS_gettime] = sys_gettime,
+    [SYS_clock_gettime] = sys_clock_gettime,
+    [SYS_nanosleep] = sys_nanosleep,
     [SYS_putc] = sys_putc,
     [SYS_pgdir] = sys_page_dir,
     [SYS_mmap] = sys_mmap,
     [SYS_munmap] = sys_munmap,
     [SYS_shmem] = sys_shmem,
+    [SYS_fault_around] = sys_fault_around,
+    [SYS_pgfaults] = sys_pgfaults,
+    [SYS_kmonitor] = sys_kmonitor,
     [SYS_sem_init] = sys_sem_init,
     [SYS_sem_post] = sys_sem_post,
     [SYS_sem_wait] = sys_sem_wait,
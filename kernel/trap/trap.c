@@ -13,6 +13,11 @@
 #include <syscall.h>
 #include <error.h>
 #include <schedule.h>
+#include <lapic.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <tick.h>
+#include <fpu.h>
 
 #define TICK		30
 
@@ -33,6 +38,11 @@ void idt_init() {
 	}
 	// 0x80陷阱门的权限为3，当发生中断时，会发生权限提升
 	SETGATE(idt[T_SYSCALL], 1, GD_KTEXT, __vectors[T_SYSCALL], DPL_USER);
+	idt_load();
+}
+
+// 所有cpu共用一个idt，ap启动时只需要加载即可
+void idt_load(void) {
 	lidt(&idt_pd);
 }
 
@@ -153,6 +163,11 @@ static void trap_dispatch(struct TrapFrame *tf) {
 	int ret;
 
 	size_t tick;
+	// 来自lapic定时器、ioapic和ipi的中断都需要应答lapic，伪中断除外
+	// 使用8259A时为自动EOI模式，lapic为NULL，lapic_eoi什么也不做
+	if (tf->tf_trap_no >= IRQ_OFFSET && tf->tf_trap_no < IRQ_OFFSET + IRQ_SPURIOUS) {
+		lapic_eoi();
+	}
 	switch (tf->tf_trap_no) {
 		case T_PG_FAULT:
 			if ((ret = page_fault_handler(tf)) != 0) {
@@ -174,19 +189,46 @@ static void trap_dispatch(struct TrapFrame *tf) {
 		case T_SYSCALL:
 			syscall();
 			break;
+		case T_DEVICE:
+			// CR0.TS置位后第一次使用fpu，恢复当前进程的fpu状态
+			if (trap_in_kernel(tf)) {
+				print_trap_frame(tf);
+				panic("fpu used in kernel mode.\n");
+			}
+			if ((ret = fpu_trap()) != 0) {
+				printk("fpu state alloc failed, killed by kernel.\n");
+				do_exit(ret);
+			}
+			break;
 		case IRQ_OFFSET + IRQ_TIMER:
 			// printk("fall in irq timer\n");
+			// bsp的一次性定时器到期，错过的tick在idle醒来后由tick_restart补上
+			if (this_cpu()->tick_stopped) {
+				break;
+			}
+			// 高精度定时器拆开tick产生的中断，不推进系统时间
+			if (hrtimer_interrupt()) {
+				break;
+			}
+			// 每个cpu都有时钟中断，只由bsp推进系统时间
 			tick = get_ticks();
-			tick++;
-			set_ticks(tick);
+			if (this_cpu()->id == 0) {
+				tick++;
+				set_ticks(tick);
+			}
 			run_timer_list();
-			if (tick % TICK == 0) {
+			if (this_cpu()->id == 0 && tick % TICK == 0) {
 				// print_hz();
 				// printk("%d ticks\n", tick);
 				assert(current != NULL);
 				// 将进程调度出去
 				current->need_resched = 1;
 			}
+			tick_nohz_busy();
+			break;
+		case T_IPI_RESCHED:
+			lapic_eoi();
+			tick_resched_ipi();
 			break;
 		case IRQ_OFFSET + IRQ_COM1:
 			// c = console_getc();
@@ -202,6 +244,12 @@ static void trap_dispatch(struct TrapFrame *tf) {
     	case IRQ_OFFSET + IRQ_IDE2:
         	/* do nothing */
         	break;
+		case IRQ_OFFSET + IRQ_SPURIOUS:
+			/* do nothing */
+			break;
+		case IRQ_OFFSET + IRQ_ERROR:
+			printk("cpu %d: lapic error interrupt.\n", this_cpu()->id);
+			break;
 		default:
 			print_trap_frame(tf);
 			if (current != NULL) {
@@ -214,6 +262,20 @@ static void trap_dispatch(struct TrapFrame *tf) {
 
 void trap(struct TrapFrame *tf)
 {
+	// tlb shootdown由持有大内核锁的cpu发起，处理时不能再去获取锁
+	if (tf->tf_trap_no == T_IPI_TLB) {
+		tlb_shootdown_handler();
+		lapic_eoi();
+		return;
+	}
+
+	// 用户态或者idle等待时进入内核，需要先获取大内核锁
+	bool locked = false;
+	if (!kernel_locked()) {
+		lock_kernel();
+		locked = true;
+	}
+
 	if (current == NULL) {
 		// used for previous projects
 		trap_dispatch(tf);
@@ -236,4 +298,9 @@ void trap(struct TrapFrame *tf)
 			}
 		}
 	}
+
+	// 返回用户态前释放大内核锁(包括内核线程通过execve变成用户进程的情况)
+	if (locked || !trap_in_kernel(tf)) {
+		unlock_kernel();
+	}
 }
\ No newline at end of file
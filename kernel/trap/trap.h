@@ -39,6 +39,11 @@
 #define IRQ_IDE1		14
 #define IRQ_IDE2		15
 #define IRQ_ERROR		19
+#define IRQ_SPURIOUS	31
+
+// 处理器间中断
+#define T_IPI_TLB		0x81
+#define T_IPI_RESCHED	0x82
 
 #define T_SWITCH_TO_USER	120
 #define T_SWITCH_TO_KERNEL	121
@@ -80,6 +85,7 @@ struct TrapFrame {
 
 
 void idt_init(void);
+void idt_load(void);
 void print_trap_frame(struct TrapFrame *tf);
 void print_regs(struct PushRegs *regs);
 bool trap_in_kernel(struct TrapFrame *tf);
@@ -0,0 +1,39 @@
+#ifndef __LIBS_TIME_H__
+#define __LIBS_TIME_H__
+
+#include <types.h>
+#include <x86.h>
+
+#define NSEC_PER_USEC       1000
+#define NSEC_PER_MSEC       1000000
+#define NSEC_PER_SEC        1000000000
+
+// 系统没有实时时钟，两种时钟都是从启动开始计时的单调时钟
+#define CLOCK_REALTIME      0
+#define CLOCK_MONOTONIC     1
+
+struct timespec {
+    long tv_sec;
+    long tv_nsec;
+};
+
+// tsc周期数换算为纳秒：ns = cycles * mult >> TSC_SHIFT，
+// mult在启动时根据8253校准得到，没有libgcc，因此把64位乘法拆成两个32位乘法
+#define TSC_SHIFT           22
+
+static inline uint64_t cycles_to_ns(uint64_t cycles, uint32_t mult) {
+    uint32_t hi = (uint32_t)(cycles >> 32);
+    uint32_t lo = (uint32_t)cycles;
+    return (((uint64_t)lo * mult) >> TSC_SHIFT) + (((uint64_t)hi * mult) << (32 - TSC_SHIFT));
+}
+
+static inline void ns_to_timespec(uint64_t ns, struct timespec *ts) {
+    ts->tv_nsec = do_div(ns, NSEC_PER_SEC);
+    ts->tv_sec = (long)ns;
+}
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+#endif // __LIBS_TIME_H__
@@ -9,16 +9,25 @@
 #define SYS_wait            3
 #define SYS_exec            4
 #define SYS_clone           5
+#define SYS_vfork           6
+#define SYS_spawn           7
+#define SYS_exec_file       8
 #define SYS_exit_thread     9
 #define SYS_yield           10
 #define SYS_sleep           11
 #define SYS_kill            12
+#define SYS_nice            13
+#define SYS_clock_gettime   14
+#define SYS_nanosleep       15
 #define SYS_gettime         17
 #define SYS_getpid          18
 #define SYS_brk             19
 #define SYS_mmap            20
 #define SYS_munmap          21
 #define SYS_shmem           22
+#define SYS_fault_around    23
+#define SYS_pgfaults        24
+#define SYS_kmonitor        25
 #define SYS_putc            30
 #define SYS_pgdir           31
 #define SYS_sem_init        40
@@ -50,6 +59,7 @@
 #define CLONE_THREAD    0x00000200  // 线程组
 #define CLONE_SEM       0x00000400  // 信号量
 #define CLONE_FS        0x00000800   // 共享打开的文件
+#define CLONE_VFORK     0x00001000  // 父进程等待子进程exec或者退出后才返回
 
 // SYS_mmap flags
 #define MMAP_WRITE      0x00000100  
@@ -0,0 +1,16 @@
+#ifndef __LIBS_VDSO_DATA_H__
+#define __LIBS_VDSO_DATA_H__
+
+#include <types.h>
+
+// 内核在每个用户地址空间的VDSO_BASE处映射一个只读页(紧挨着用户栈的下方，见memlayout.h)，
+// 用户程序直接读取其中的数据，不需要陷入内核
+#define VDSO_BASE       0xAFEFF000
+
+typedef struct {
+    uint64_t tsc_base;      // 启动时的tsc
+    uint32_t tsc_mult;      // tsc周期到纳秒的换算系数，见time.h的cycles_to_ns
+    int pid;                // 地址空间所属进程的pid，被多个线程共享时为0，需要走系统调用
+} VdsoData;
+
+#endif // __LIBS_VDSO_DATA_H__
@@ -134,6 +134,11 @@ static inline void sti(void) {
     asm volatile ("sti");
 }
 
+// sti之后的下一条指令执行完才会响应中断，所以sti和hlt之间不会丢失唤醒
+static inline void sti_hlt(void) {
+	asm volatile("sti; hlt" ::: "memory");
+}
+
 static inline void cli(void) {
     asm volatile ("cli" ::: "memory");
 }
@@ -142,6 +147,33 @@ static inline void ltr(uint16_t sel) {
     asm volatile ("ltr %0" :: "r" (sel) : "memory");
 }
 
+static inline uint32_t xchg(volatile uint32_t *addr, uint32_t newval) {
+	uint32_t result;
+	// xchg指令带有隐含的lock前缀
+	asm volatile("lock; xchgl %0, %1"
+		: "+m" (*addr), "=a" (result)
+		: "1" (newval)
+		: "cc");
+	return result;
+}
+
+// 返回最低的置位比特的下标，value不能为0
+static inline uint32_t bsf(uint32_t value) {
+	uint32_t index;
+	asm volatile("bsfl %1, %0" : "=r" (index) : "rm" (value) : "cc");
+	return index;
+}
+
+static inline uint64_t read_tsc(void) {
+	uint64_t tsc;
+	asm volatile("rdtsc" : "=A" (tsc));
+	return tsc;
+}
+
+static inline void pause(void) {
+	asm volatile("pause" ::: "memory");
+}
+
 static inline uint32_t read_eflags(void) {
 	uint32_t eflags;
 	asm volatile("pushfl; popl %0" : "=r" (eflags));
@@ -166,6 +198,32 @@ static inline uintptr_t rcr0(void) {
 	return cr0;
 }
 
+static inline void lcr4(uintptr_t cr4) {
+	asm volatile("mov %0, %%cr4" :: "r" (cr4) : "memory");
+}
+
+static inline uintptr_t rcr4(void) {
+	uintptr_t cr4;
+	asm volatile("mov %%cr4, %0" : "=r" (cr4) :: "memory");
+	return cr4;
+}
+
+static inline void clts(void) {
+	asm volatile("clts" ::: "memory");
+}
+
+static inline void cpuid(uint32_t info, uint32_t *eaxp, uint32_t *ebxp,
+		uint32_t *ecxp, uint32_t *edxp) {
+	uint32_t eax, ebx, ecx, edx;
+	asm volatile("cpuid"
+		: "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+		: "a" (info));
+	if (eaxp) *eaxp = eax;
+	if (ebxp) *ebxp = ebx;
+	if (ecxp) *ecxp = ecx;
+	if (edxp) *edxp = edx;
+}
+
 static inline uintptr_t rcr2(void) {
 	uintptr_t cr2;
 	asm volatile("mov %%cr2, %0" : "=r" (cr2) :: "memory");
@@ -0,0 +1,374 @@
+
+obj/boot/boot.out:     file format elf32-i386
+
+
+Disassembly of section .text:
+
+00007c00 <start>:
+
+# start address should be 0:7c00, in real mode, the beginning address of the running bootloader
+.globl start
+start:
+.code16                                             # Assemble for 16-bit mode
+    cli                                             # Disable interrupts
+    7c00:	fa                   	cli
+    cld                                             # String operations increment
+    7c01:	fc                   	cld
+
+    # Set up the important data segment registers (DS, ES, SS).
+    xorw %ax, %ax                                   # Segment number zero
+    7c02:	31 c0                	xor    %eax,%eax
+    movw %ax, %ds                                   # -> Data Segment
+    7c04:	8e d8                	mov    %eax,%ds
+    movw %ax, %es                                   # -> Extra Segment
+    7c06:	8e c0                	mov    %eax,%es
+    movw %ax, %ss                                   # -> Stack Segment
+    7c08:	8e d0                	mov    %eax,%ss
+
+00007c0a <seta20.1>:
+    # Enable A20:
+    #  For backwards compatibility with the earliest PCs, physical
+    #  address line 20 is tied low, so that addresses higher than
+    #  1MB wrap around to zero by default. This code undoes this.
+seta20.1:
+    inb $0x64, %al                                  # Wait for not busy(8042 input buffer empty).
+    7c0a:	e4 64                	in     $0x64,%al
+    testb $0x2, %al
+    7c0c:	a8 02                	test   $0x2,%al
+    jnz seta20.1
+    7c0e:	75 fa                	jne    7c0a <seta20.1>
+
+    movb $0xd1, %al                                 # 0xd1 -> port 0x64
+    7c10:	b0 d1                	mov    $0xd1,%al
+    outb %al, $0x64                                 # 0xd1 means: write data to 8042's P2 port
+    7c12:	e6 64                	out    %al,$0x64
+
+00007c14 <seta20.2>:
+
+seta20.2:
+    inb $0x64, %al                                  # Wait for not busy(8042 input buffer empty).
+    7c14:	e4 64                	in     $0x64,%al
+    testb $0x2, %al
+    7c16:	a8 02                	test   $0x2,%al
+    jnz seta20.2
+    7c18:	75 fa                	jne    7c14 <seta20.2>
+
+    movb $0xdf, %al                                 # 0xdf -> port 0x60
+    7c1a:	b0 df                	mov    $0xdf,%al
+    outb %al, $0x60                                 # 0xdf = 11011111, means set P2's A20 bit(the 1 bit) to 1
+    7c1c:	e6 60                	out    %al,$0x60
+
+00007c1e <probe_memory>:
+
+probe_memory:
+    movl $0, 0x8000
+    7c1e:	66 c7 06 00 80       	movw   $0x8000,(%esi)
+    7c23:	00 00                	add    %al,(%eax)
+    7c25:	00 00                	add    %al,(%eax)
+    xorl %ebx, %ebx
+    7c27:	66 31 db             	xor    %bx,%bx
+    movw $0x8004, %di
+    7c2a:	bf                   	.byte 0xbf
+    7c2b:	04 80                	add    $0x80,%al
+
+00007c2d <start_probe>:
+start_probe:
+    movl $0xE820, %eax
+    7c2d:	66 b8 20 e8          	mov    $0xe820,%ax
+    7c31:	00 00                	add    %al,(%eax)
+    movl $20, %ecx
+    7c33:	66 b9 14 00          	mov    $0x14,%cx
+    7c37:	00 00                	add    %al,(%eax)
+    movl $SMAP, %edx
+    7c39:	66 ba 50 41          	mov    $0x4150,%dx
+    7c3d:	4d                   	dec    %ebp
+    7c3e:	53                   	push   %ebx
+    int $0x15
+    7c3f:	cd 15                	int    $0x15
+    jnc cont
+    7c41:	73 08                	jae    7c4b <cont>
+    movw $12345, 0x8000
+    7c43:	c7 06 00 80 39 30    	movl   $0x30398000,(%esi)
+    jmp finish_probe
+    7c49:	eb 0e                	jmp    7c59 <finish_probe>
+
+00007c4b <cont>:
+cont:
+    addw $20, %di
+    7c4b:	83 c7 14             	add    $0x14,%edi
+    incl 0x8000
+    7c4e:	66 ff 06             	incw   (%esi)
+    7c51:	00 80 66 83 fb 00    	add    %al,0xfb8366(%eax)
+    cmpl $0, %ebx
+    jnz start_probe
+    7c57:	75 d4                	jne    7c2d <start_probe>
+
+00007c59 <finish_probe>:
+
+    # Switch from real to protected mode, using a bootstrap GDT
+    # and segment translation that makes virtual addresses
+    # identical to physical addresses, so that the
+    # effective memory map does not change during the switch.
+    lgdt gdtdesc
+    7c59:	0f 01 16             	lgdtl  (%esi)
+    7c5c:	a4                   	movsb  %ds:(%esi),%es:(%edi)
+    7c5d:	7c 0f                	jl     7c6e <protcseg+0x1>
+    movl %cr0, %eax
+    7c5f:	20 c0                	and    %al,%al
+    orl $CR0_PE_ON, %eax
+    7c61:	66 83 c8 01          	or     $0x1,%ax
+    movl %eax, %cr0
+    7c65:	0f 22 c0             	mov    %eax,%cr0
+
+    # Jump to next instruction, but in 32-bit code segment.
+    # Switches processor into 32-bit mode.
+    ljmp $PROT_MODE_CSEG, $protcseg
+    7c68:	ea                   	.byte 0xea
+    7c69:	6d                   	insl   (%dx),%es:(%edi)
+    7c6a:	7c 08                	jl     7c74 <protcseg+0x7>
+	...
+
+00007c6d <protcseg>:
+
+.code32                                             # Assemble for 32-bit mode
+protcseg:
+    # Set up the protected-mode data segment registers
+    movw $PROT_MODE_DSEG, %ax                       # Our data segment selector
+    7c6d:	66 b8 10 00          	mov    $0x10,%ax
+    movw %ax, %ds                                   # -> DS: Data Segment
+    7c71:	8e d8                	mov    %eax,%ds
+    movw %ax, %es                                   # -> ES: Extra Segment
+    7c73:	8e c0                	mov    %eax,%es
+    movw %ax, %fs                                   # -> FS
+    7c75:	8e e0                	mov    %eax,%fs
+    movw %ax, %gs                                   # -> GS
+    7c77:	8e e8                	mov    %eax,%gs
+    movw %ax, %ss                                   # -> SS: Stack Segment
+    7c79:	8e d0                	mov    %eax,%ss
+
+    # Set up the stack pointer and call into C. The stack region is from 0--start(0x7c00)
+    movl $0x0, %ebp
+    7c7b:	bd 00 00 00 00       	mov    $0x0,%ebp
+    movl $start, %esp
+    7c80:	bc 00 7c 00 00       	mov    $0x7c00,%esp
+    call boot_main
+    7c85:	e8 cf 00 00 00       	call   7d59 <boot_main>
+
+00007c8a <spin>:
+
+    # If bootmain returns (it shouldn't), loop.
+spin:
+    jmp spin
+    7c8a:	eb fe                	jmp    7c8a <spin>
+
+00007c8c <gdt>:
+	...
+    7c94:	ff                   	(bad)
+    7c95:	ff 00                	incl   (%eax)
+    7c97:	00 00                	add    %al,(%eax)
+    7c99:	9a cf 00 ff ff 00 00 	lcall  $0x0,$0xffff00cf
+    7ca0:	00                   	.byte 0x0
+    7ca1:	92                   	xchg   %eax,%edx
+    7ca2:	cf                   	iret
+	...
+
+00007ca4 <gdtdesc>:
+    7ca4:	17                   	pop    %ss
+    7ca5:	00                   	.byte 0x0
+    7ca6:	8c 7c 00 00          	mov    %?,0x0(%eax,%eax,1)
+
+00007caa <wait_disk>:
+}
+
+static inline uint8_t inb(int port)
+{
+	uint8_t data;
+	asm volatile("inb %w1, %0": "=a" (data) : "d" (port));
+    7caa:	ba f7 01 00 00       	mov    $0x1f7,%edx
+    7caf:	ec                   	in     (%dx),%al
+	}
+}
+
+void wait_disk(void)
+{
+	while ((inb(0x1f7) & 0xc0) != 0x40);
+    7cb0:	83 e0 c0             	and    $0xffffffc0,%eax
+    7cb3:	3c 40                	cmp    $0x40,%al
+    7cb5:	75 f8                	jne    7caf <wait_disk+0x5>
+}
+    7cb7:	c3                   	ret
+
+00007cb8 <read_sect>:
+
+void read_sect(void *dst, uint32_t offset)
+{
+    7cb8:	55                   	push   %ebp
+    7cb9:	89 e5                	mov    %esp,%ebp
+    7cbb:	57                   	push   %edi
+    7cbc:	50                   	push   %eax
+    7cbd:	8b 4d 0c             	mov    0xc(%ebp),%ecx
+	wait_disk();
+    7cc0:	e8 e5 ff ff ff       	call   7caa <wait_disk>
+		: "memory", "cc");
+}
+
+static inline void outb(int port, uint8_t data)
+{
+	asm volatile("outb %0, %w1":: "a" (data), "d" (port));
+    7cc5:	b0 01                	mov    $0x1,%al
+    7cc7:	ba f2 01 00 00       	mov    $0x1f2,%edx
+    7ccc:	ee                   	out    %al,(%dx)
+    7ccd:	ba f3 01 00 00       	mov    $0x1f3,%edx
+    7cd2:	89 c8                	mov    %ecx,%eax
+    7cd4:	ee                   	out    %al,(%dx)
+		
+	outb(0x1f2, 1);	// count = 1
+	outb(0x1f3, offset);
+	outb(0x1f4, offset >> 8);
+    7cd5:	89 c8                	mov    %ecx,%eax
+    7cd7:	ba f4 01 00 00       	mov    $0x1f4,%edx
+    7cdc:	c1 e8 08             	shr    $0x8,%eax
+    7cdf:	ee                   	out    %al,(%dx)
+	outb(0x1f5, offset >> 16);
+    7ce0:	89 c8                	mov    %ecx,%eax
+    7ce2:	ba f5 01 00 00       	mov    $0x1f5,%edx
+    7ce7:	c1 e8 10             	shr    $0x10,%eax
+    7cea:	ee                   	out    %al,(%dx)
+	outb(0x1f6, (offset >> 24) | 0xe0);	
+    7ceb:	89 c8                	mov    %ecx,%eax
+    7ced:	ba f6 01 00 00       	mov    $0x1f6,%edx
+    7cf2:	c1 e8 18             	shr    $0x18,%eax
+    7cf5:	83 c8 e0             	or     $0xffffffe0,%eax
+    7cf8:	ee                   	out    %al,(%dx)
+    7cf9:	b0 20                	mov    $0x20,%al
+    7cfb:	ba f7 01 00 00       	mov    $0x1f7,%edx
+    7d00:	ee                   	out    %al,(%dx)
+	outb(0x1f7, 0x20);	// cmd 0x20 -> read sectors
+
+	wait_disk();
+    7d01:	e8 a4 ff ff ff       	call   7caa <wait_disk>
+	asm volatile("cld\n\trepne\n\tinsl"
+    7d06:	b9 80 00 00 00       	mov    $0x80,%ecx
+    7d0b:	8b 7d 08             	mov    0x8(%ebp),%edi
+    7d0e:	ba f0 01 00 00       	mov    $0x1f0,%edx
+    7d13:	fc                   	cld
+    7d14:	f2 6d                	repnz insl (%dx),%es:(%edi)
+
+	insl(0x1f0, dst, SECT_SIZE / 4);
+}
+    7d16:	5a                   	pop    %edx
+    7d17:	5f                   	pop    %edi
+    7d18:	5d                   	pop    %ebp
+    7d19:	c3                   	ret
+
+00007d1a <read_seg>:
+{
+    7d1a:	55                   	push   %ebp
+    7d1b:	89 e5                	mov    %esp,%ebp
+    7d1d:	57                   	push   %edi
+    7d1e:	56                   	push   %esi
+    7d1f:	53                   	push   %ebx
+    7d20:	83 ec 0c             	sub    $0xc,%esp
+	offset = (offset / SECT_SIZE) + 1;
+    7d23:	8b 7d 10             	mov    0x10(%ebp),%edi
+{
+    7d26:	8b 5d 08             	mov    0x8(%ebp),%ebx
+	end_pa = pa + count;
+    7d29:	8b 75 0c             	mov    0xc(%ebp),%esi
+	offset = (offset / SECT_SIZE) + 1;
+    7d2c:	c1 ef 09             	shr    $0x9,%edi
+	end_pa = pa + count;
+    7d2f:	01 de                	add    %ebx,%esi
+	offset = (offset / SECT_SIZE) + 1;
+    7d31:	47                   	inc    %edi
+	pa &= ~(SECT_SIZE - 1);
+    7d32:	81 e3 00 fe ff ff    	and    $0xfffffe00,%ebx
+	while (pa < end_pa) {
+    7d38:	39 f3                	cmp    %esi,%ebx
+    7d3a:	73 15                	jae    7d51 <read_seg+0x37>
+		read_sect((void*)pa, offset);
+    7d3c:	50                   	push   %eax
+    7d3d:	50                   	push   %eax
+    7d3e:	57                   	push   %edi
+		offset++;
+    7d3f:	47                   	inc    %edi
+		read_sect((void*)pa, offset);
+    7d40:	53                   	push   %ebx
+		pa += SECT_SIZE;
+    7d41:	81 c3 00 02 00 00    	add    $0x200,%ebx
+		read_sect((void*)pa, offset);
+    7d47:	e8 6c ff ff ff       	call   7cb8 <read_sect>
+		offset++;
+    7d4c:	83 c4 10             	add    $0x10,%esp
+    7d4f:	eb e7                	jmp    7d38 <read_seg+0x1e>
+}
+    7d51:	8d 65 f4             	lea    -0xc(%ebp),%esp
+    7d54:	5b                   	pop    %ebx
+    7d55:	5e                   	pop    %esi
+    7d56:	5f                   	pop    %edi
+    7d57:	5d                   	pop    %ebp
+    7d58:	c3                   	ret
+
+00007d59 <boot_main>:
+{
+    7d59:	55                   	push   %ebp
+    7d5a:	89 e5                	mov    %esp,%ebp
+    7d5c:	56                   	push   %esi
+    7d5d:	53                   	push   %ebx
+	read_seg((uintptr_t) ELF_HDR, SECT_SIZE * 8, 0);
+    7d5e:	52                   	push   %edx
+    7d5f:	6a 00                	push   $0x0
+    7d61:	68 00 10 00 00       	push   $0x1000
+    7d66:	68 00 00 01 00       	push   $0x10000
+    7d6b:	e8 aa ff ff ff       	call   7d1a <read_seg>
+	if (ELF_HDR->e_magic != ELF_MAGIC) {
+    7d70:	83 c4 10             	add    $0x10,%esp
+    7d73:	81 3d 00 00 01 00 7f 	cmpl   $0x464c457f,0x10000
+    7d7a:	45 4c 46 
+    7d7d:	75 3e                	jne    7dbd <boot_main+0x64>
+	ph = (struct ProgHeader*)((void*)ELF_HDR +  ELF_HDR->e_phoff);
+    7d7f:	a1 1c 00 01 00       	mov    0x1001c,%eax
+	eph = ph + ELF_HDR->e_phnum;
+    7d84:	0f b7 35 2c 00 01 00 	movzwl 0x1002c,%esi
+	ph = (struct ProgHeader*)((void*)ELF_HDR +  ELF_HDR->e_phoff);
+    7d8b:	8d 98 00 00 01 00    	lea    0x10000(%eax),%ebx
+	eph = ph + ELF_HDR->e_phnum;
+    7d91:	c1 e6 05             	shl    $0x5,%esi
+    7d94:	01 de                	add    %ebx,%esi
+	for (; ph < eph; ph++) {
+    7d96:	39 f3                	cmp    %esi,%ebx
+    7d98:	73 17                	jae    7db1 <boot_main+0x58>
+		read_seg(ph->p_pa, ph->p_memsz, ph->p_offset);
+    7d9a:	50                   	push   %eax
+	for (; ph < eph; ph++) {
+    7d9b:	83 c3 20             	add    $0x20,%ebx
+		read_seg(ph->p_pa, ph->p_memsz, ph->p_offset);
+    7d9e:	ff 73 e4             	push   -0x1c(%ebx)
+    7da1:	ff 73 f4             	push   -0xc(%ebx)
+    7da4:	ff 73 ec             	push   -0x14(%ebx)
+    7da7:	e8 6e ff ff ff       	call   7d1a <read_seg>
+	for (; ph < eph; ph++) {
+    7dac:	83 c4 10             	add    $0x10,%esp
+    7daf:	eb e5                	jmp    7d96 <boot_main+0x3d>
+	entry = (void(*)(void))(ELF_HDR->e_entry & 0xffffff);
+    7db1:	a1 18 00 01 00       	mov    0x10018,%eax
+    7db6:	25 ff ff ff 00       	and    $0xffffff,%eax
+	entry();
+    7dbb:	ff d0                	call   *%eax
+		     : "cc");
+}
+
+static inline void outw(int port, uint16_t data)
+{
+	asm volatile("outw %0,%w1" : : "a" (data), "d" (port));
+    7dbd:	ba 00 8a 00 00       	mov    $0x8a00,%edx
+    7dc2:	b8 00 8a ff ff       	mov    $0xffff8a00,%eax
+    7dc7:	66 ef                	out    %ax,(%dx)
+    7dc9:	b8 00 8e ff ff       	mov    $0xffff8e00,%eax
+    7dce:	66 ef                	out    %ax,(%dx)
+}
+    7dd0:	8d 65 f8             	lea    -0x8(%ebp),%esp
+    7dd3:	5b                   	pop    %ebx
+    7dd4:	5e                   	pop    %esi
+    7dd5:	5d                   	pop    %ebp
+    7dd6:	c3                   	ret
@@ -0,0 +1,65 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+// 顺序读一块内存时的缺页次数和时间，比较不同的fault-around窗口：
+// anon: 新mmap的匿名内存，读缺页映射零页；
+// shmem: 子进程写满共享内存后退出，父进程再读，共享内存中的page都已经在内存中了
+#define NPAGES          512
+
+static const int windows[] = {1, 4, 16, 64};
+
+// 顺序读[addr, addr + NPAGES * PAGE_SIZE)，返回读之前的缺页次数
+static int scan(uintptr_t addr, char expect, int *ns_store) {
+    int faults = pgfaults(), i;
+    uint64_t start = clock_ns();
+    for (i = 0; i < NPAGES; i++) {
+        assert(*(volatile char *)(addr + i * PAGE_SIZE) == expect);
+    }
+    *ns_store = clock_ns_per(start, NPAGES);
+    return faults;
+}
+
+static void report(const char *name, int window, int faults, int ns) {
+    printf("fault_bench: %s window %d: %d faults, %d ns/page.\n",
+        name, window, pgfaults() - faults, ns);
+}
+
+static void bench_anon(int window) {
+    uintptr_t addr = 0;
+    int ns;
+    assert(mmap(&addr, NPAGES * PAGE_SIZE, MMAP_WRITE) == 0);
+    int faults = scan(addr, 0, &ns);
+    report("anon", window, faults, ns);
+    assert(munmap(addr, NPAGES * PAGE_SIZE) == 0);
+}
+
+static void bench_shmem(int window) {
+    uintptr_t addr = 0;
+    int ns;
+    int pid, exit_code, i;
+    assert(shmem(&addr, NPAGES * PAGE_SIZE, MMAP_WRITE) == 0);
+    if ((pid = fork()) == 0) {
+        for (i = 0; i < NPAGES; i++) {
+            *(char *)(addr + i * PAGE_SIZE) = 0x5a;
+        }
+        exit(0);
+    }
+    assert(pid > 0 && waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    int faults = scan(addr, 0x5a, &ns);
+    report("shmem", window, faults, ns);
+    assert(munmap(addr, NPAGES * PAGE_SIZE) == 0);
+}
+
+int main(void) {
+    int old = fault_around(-1), i;
+    for (i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+        fault_around(windows[i]);
+        bench_anon(windows[i]);
+        bench_shmem(windows[i]);
+    }
+    fault_around(old);
+    printf("fault_bench pass.\n");
+    return 0;
+}
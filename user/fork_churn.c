@@ -0,0 +1,52 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <time.h>
+
+// fork/exit的开销随存活进程数的变化：先创建live个不回收的僵尸进程占住pid，
+// 然后反复fork一个立即退出的子进程并回收它，统计平均每次fork+exit+wait的时间。
+// pid分配使用位图后，每次fork的开销不应随live增长
+#define ITERATIONS      200
+
+#define MAX_LIVE        1024
+
+static const int live_counts[] = {0, 64, 256, MAX_LIVE};
+static int pids[MAX_LIVE];
+
+static int churn(int live) {
+    int i, pid, exit_code;
+    for (i = 0; i < live; i++) {
+        if ((pid = fork()) == 0) {
+            exit(0);
+        }
+        if (pid < 0) {
+            printf("fork_churn: only %d live processes.\n", i);
+            live = i;
+            break;
+        }
+        pids[i] = pid;
+    }
+
+    uint64_t start = clock_ns();
+    for (i = 0; i < ITERATIONS; i++) {
+        if ((pid = fork()) == 0) {
+            exit(0);
+        }
+        assert(pid > 0);
+        assert(waitpid(pid, &exit_code) == 0);
+    }
+    printf("%d live processes: %d ns per fork/exit/wait.\n", live, clock_ns_per(start, ITERATIONS));
+
+    for (i = 0; i < live; i++) {
+        assert(waitpid(pids[i], &exit_code) == 0);
+    }
+    return 0;
+}
+
+int main(void) {
+    int i;
+    for (i = 0; i < sizeof(live_counts) / sizeof(live_counts[0]); i++) {
+        assert(churn(live_counts[i]) == 0);
+    }
+    printf("fork_churn pass.\n");
+    return 0;
+}
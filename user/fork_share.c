@@ -0,0 +1,112 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+// fork时共享页表：父进程写满一块较大的内存后fork，比较不同大小下fork的耗时，
+// 并检查父子进程各自写入、解除映射之后页表复制正确，互不影响
+#define PT_SIZE         (4 * 1024 * 1024)
+
+static const int sizes[] = {1 * 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024};
+
+static char pattern(uintptr_t addr) {
+    return (char)((addr / PAGE_SIZE) * 5 + 3);
+}
+
+static void fill(uintptr_t addr, int size) {
+    uintptr_t va;
+    for (va = addr; va < addr + size; va += PAGE_SIZE) {
+        *(char *)va = pattern(va);
+    }
+}
+
+static void check(uintptr_t addr, int size, uintptr_t skip) {
+    uintptr_t va;
+    for (va = addr; va < addr + size; va += PAGE_SIZE) {
+        if (va != skip) {
+            assert(*(char *)va == pattern(va));
+        }
+    }
+}
+
+static void wait_child(int pid) {
+    int exit_code;
+    assert(pid > 0 && waitpid(pid, &exit_code) == 0 && exit_code == 0);
+}
+
+// 先读一遍再写，读缺页时已经建好了4K的页表，不会再用大页映射，
+// fork时走的是共享页表而不是共享大页
+static void bench(int size, bool read_first) {
+    uintptr_t addr = 0, va;
+    assert(mmap(&addr, size, MMAP_WRITE) == 0 && addr != 0);
+    if (read_first) {
+        for (va = addr; va < addr + size; va += PAGE_SIZE) {
+            assert(*(volatile char *)va == 0);
+        }
+    }
+    fill(addr, size);
+
+    int pid;
+    uint64_t start = clock_ns();
+    if ((pid = fork()) == 0) {
+        check(addr, size, 0);
+        *(char *)addr = 0;
+        check(addr, size, addr);
+        exit(0);
+    }
+    int us = clock_ns_per(start, 1000);
+    wait_child(pid);
+    check(addr, size, 0);
+    printf("fork_share: %d KB resident%s, fork %d us.\n",
+        size / 1024, read_first ? " (4K tables)" : "", us);
+    assert(munmap(addr, size) == 0);
+}
+
+// 在一个对齐的4M区域中放两个相邻的1M的vma，它们共用一个页表，但都没有覆盖整个页表
+static uintptr_t map_pair(void) {
+    uintptr_t base = 0, addr;
+    assert(mmap(&base, 2 * PT_SIZE, MMAP_WRITE) == 0 && munmap(base, 2 * PT_SIZE) == 0);
+    base = ROUNDUP(base, PT_SIZE);
+    addr = base;
+    assert(mmap(&addr, PT_SIZE / 4, MMAP_WRITE) == 0 && addr == base);
+    addr = base + PT_SIZE / 4;
+    assert(mmap(&addr, PT_SIZE / 4, MMAP_WRITE) == 0 && addr == base + PT_SIZE / 4);
+    fill(base, PT_SIZE / 2);
+    return base;
+}
+
+static void unmap_shared(void) {
+    uintptr_t base = map_pair();
+    int pid;
+
+    // 子进程用对齐的4M范围解除映射，范围里的每个vma都只占页表的一部分
+    if ((pid = fork()) == 0) {
+        assert(munmap(base, PT_SIZE) == 0);
+        exit(0);
+    }
+    wait_child(pid);
+    check(base, PT_SIZE / 2, 0);
+
+    // 子进程只解除第二个vma中的一部分，父进程再解除整个4M，子进程的页表不受影响
+    if ((pid = fork()) == 0) {
+        assert(munmap(base + PT_SIZE / 4 + PAGE_SIZE, PAGE_SIZE) == 0);
+        yield();
+        check(base, PT_SIZE / 4, 0);
+        check(base + PT_SIZE / 4 + 2 * PAGE_SIZE, PT_SIZE / 4 - 2 * PAGE_SIZE, 0);
+        exit(0);
+    }
+    assert(munmap(base, PT_SIZE) == 0);
+    wait_child(pid);
+    printf("fork_share: munmap of shared page table ok.\n");
+}
+
+int main(void) {
+    int i;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench(sizes[i], 0);
+        bench(sizes[i], 1);
+    }
+    unmap_shared();
+    printf("fork_share pass.\n");
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <ulib.h>
+#include <stdio.h>
+
+// 多个进程交替使用fpu，检查进程切换后fpu寄存器中的值没有被其他进程破坏
+#define NPROCESS        4
+#define ITERATIONS      200
+
+static int fpu_loop(int id) {
+    int i;
+    double value = id + 1, result;
+    for (i = 0; i < ITERATIONS; i++) {
+        // 把值留在fpu寄存器栈中跨越yield，只有内核正确保存/恢复fpu状态才能读回原值
+        asm volatile("fldl %0" :: "m" (value));
+        yield();
+        asm volatile("fstpl %0" : "=m" (result));
+        if (result != value) {
+            printf("fpu_test: process %d lost fpu state at %d.\n", id, i);
+            return -1;
+        }
+        value = value * 2 + 1;
+        if (value > 1e9) {
+            value = id + 1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    int i, pid, exit_code, failed = 0;
+    int pids[NPROCESS];
+    for (i = 0; i < NPROCESS; i++) {
+        if ((pid = fork()) == 0) {
+            exit(fpu_loop(i));
+        }
+        assert(pid > 0);
+        pids[i] = pid;
+    }
+    // 父进程也使用fpu，fork出的子进程继承父进程的fpu状态
+    if (fpu_loop(NPROCESS) != 0) {
+        failed++;
+    }
+    for (i = 0; i < NPROCESS; i++) {
+        if (waitpid(pids[i], &exit_code) != 0 || exit_code != 0) {
+            failed++;
+        }
+    }
+    assert(failed == 0);
+    printf("fpu_test pass.\n");
+    return 0;
+}
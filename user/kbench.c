@@ -0,0 +1,25 @@
+#include <ulib.h>
+#include <stdio.h>
+
+// 在运行中的系统上查看内存和调度的统计信息，并运行内核中的微基准测试，结果由内核打印
+static const char *commands[] = {
+    "schedule_info",
+    "timer_bench 10000",
+    "slab_info",
+    "slab_bench 100000",
+    "shrinker_info",
+    "buddy_stat",
+    "page_bench 100000",
+    "tlb_bench 64",
+};
+
+int main(void) {
+    int i;
+    for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        printf("kbench: %s\n", commands[i]);
+        assert(kmonitor(commands[i]) == 0);
+    }
+    assert(kmonitor("no_such_command") != 0);
+    printf("kbench pass.\n");
+    return 0;
+}
@@ -23,8 +23,10 @@ static inline void lock(lock_t *lock) {
         do {
             yield();
             if (++step == 100) {
+                // 退避100us，而不是整整10个tick
+                static const struct timespec backoff = {0, 100 * NSEC_PER_USEC};
                 step = 0;
-                sleep(10);
+                nanosleep(&backoff);
             }
         } while (!try_lock(lock));
     }
@@ -37,6 +37,14 @@ int sys_fork(void) {
     return syscall(SYS_fork);
 }
 
+int sys_spawn(const char *path) {
+    return syscall(SYS_spawn, path);
+}
+
+int sys_exec_file(const char *path) {
+    return syscall(SYS_exec_file, path);
+}
+
 int sys_wait(int pid, int *store) {
     return syscall(SYS_wait, pid, store);
 }
@@ -53,10 +61,22 @@ int sys_sleep(unsigned int time) {
     return syscall(SYS_sleep, time);
 }
 
+int sys_clock_gettime(int clock_id, struct timespec *ts) {
+    return syscall(SYS_clock_gettime, clock_id, ts);
+}
+
+int sys_nanosleep(const struct timespec *req) {
+    return syscall(SYS_nanosleep, req);
+}
+
 size_t sys_gettime(void) {
     return syscall(SYS_gettime);
 }
 
+int sys_nice(int nice) {
+    return syscall(SYS_nice, nice);
+}
+
 int sys_getpid(void) {
     return syscall(SYS_getpid);
 }
@@ -85,6 +105,18 @@ int sys_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
     return syscall(SYS_shmem, addr_store, len, mmap_flags);
 }
 
+int sys_fault_around(int npages) {
+    return syscall(SYS_fault_around, npages);
+}
+
+int sys_pgfaults(void) {
+    return syscall(SYS_pgfaults);
+}
+
+int sys_kmonitor(const char *cmd) {
+    return syscall(SYS_kmonitor, cmd);
+}
+
 sem_t sys_sem_init(int value) {
     return syscall(SYS_sem_init, value);
 }
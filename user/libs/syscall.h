@@ -2,21 +2,30 @@
 #define __USER_LIBS_SYSCALL_H__
 
 #include <types.h>
+#include <time.h>
 
 int sys_exit(int error_code);
 int sys_fork(void);
 int sys_wait(int pid, int *store);
+int sys_spawn(const char *path);
+int sys_exec_file(const char *path);
 int sys_yield(void);
 int sys_sleep(unsigned int time);
 int sys_kill(int pid);
 size_t sys_gettime(void);
+int sys_clock_gettime(int clock_id, struct timespec *ts);
+int sys_nanosleep(const struct timespec *req);
 int sys_getpid(void);
+int sys_nice(int nice);
 int sys_brk(uintptr_t *brk_store);
 int sys_putc(int c);
 int sys_page_dir(void);
 int sys_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 int sys_munmap(uintptr_t addr, size_t len);
 int sys_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
+int sys_fault_around(int npages);
+int sys_pgfaults(void);
+int sys_kmonitor(const char *cmd);
 sem_t sys_sem_init(int value);
 int sys_sem_post(sem_t sem_id);
 int sys_sem_wait(sem_t sem_id);
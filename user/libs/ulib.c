@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <types.h>
 #include <lock.h>
+#include <vdso_data.h>
 
 static lock_t fork_lock = INIT_LOCK;
 
@@ -29,6 +30,16 @@ int fork(void) {
     return ret;
 }
 
+// 创建一个执行path的子进程，返回子进程的pid
+int spawn(const char *path) {
+    return sys_spawn(path);
+}
+
+// 成功时不会返回
+int exec(const char *path) {
+    return sys_exec_file(path);
+}
+
 int wait(void) {
     return sys_wait(0, NULL);
 }
@@ -49,11 +60,51 @@ int sleep(unsigned int time) {
     return sys_sleep(time);
 }
 
+// 通过内核映射的vdso页读取时钟数据，直接用tsc计算时间，不需要系统调用
+static inline uint64_t vdso_clock_ns(void) {
+    const VdsoData *vdso = (const VdsoData *)VDSO_BASE;
+    return cycles_to_ns(read_tsc() - vdso->tsc_base, vdso->tsc_mult);
+}
+
 unsigned int gettime_msec(void) {
-    return sys_gettime();
+    uint64_t ns = vdso_clock_ns();
+    do_div(ns, NSEC_PER_MSEC);
+    return (unsigned int)ns;
+}
+
+int clock_gettime(int clock_id, struct timespec *ts) {
+    if (clock_id != CLOCK_REALTIME && clock_id != CLOCK_MONOTONIC) {
+        return sys_clock_gettime(clock_id, ts);
+    }
+    ns_to_timespec(vdso_clock_ns(), ts);
+    return 0;
+}
+
+// CLOCK_MONOTONIC的纳秒数
+uint64_t clock_ns(void) {
+    return vdso_clock_ns();
+}
+
+// 从start(clock_ns()的返回值)到现在经过的时间平均到n次操作上，测试程序用来报告每次操作的耗时
+int clock_ns_per(uint64_t start, uint32_t n) {
+    uint64_t ns = vdso_clock_ns() - start;
+    do_div(ns, n);
+    return (int)ns;
+}
+
+int nanosleep(const struct timespec *req) {
+    return sys_nanosleep(req);
+}
+
+int nice(int nice) {
+    return sys_nice(nice);
 }
 
 int getpid(void) {
+    const VdsoData *vdso = (const VdsoData *)VDSO_BASE;
+    if (vdso->pid > 0) {
+        return vdso->pid;
+    }
     return sys_getpid();
 }
 
@@ -73,6 +124,21 @@ int shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
     return sys_shmem(addr_store, len, mmap_flags);
 }
 
+// 设置缺页时顺便映射的相邻page数，npages小于0时只查询，返回之前的值
+int fault_around(int npages) {
+    return sys_fault_around(npages);
+}
+
+// 当前进程发生缺页的次数
+int pgfaults(void) {
+    return sys_pgfaults();
+}
+
+// 执行一条内核监视器命令(比如slab_info、timer_bench 10000)，结果由内核打印到控制台
+int kmonitor(const char *cmd) {
+    return sys_kmonitor(cmd);
+}
+
 sem_t sem_init(int value) {
     return sys_sem_init(value);
 }
@@ -2,6 +2,10 @@
 #define __USER_LIBS_ULIB_H__
 
 #include <types.h>
+#include <time.h>
+
+// 用户程序按页访问内存时使用的页大小
+#define PAGE_SIZE           4096
 
 void __warn(const char *file, int line, const char *fmt, ...);
 void __panic(const char *file, int line, const char *fmt, ...) __attribute__((noreturn));
@@ -27,17 +31,30 @@ int fprintf(int fd, const char *fmt, ...);
 
 void exit(int error_code) __attribute__((noreturn));
 int fork(void);
+// 子进程共享父进程的地址空间，父进程在子进程exec或者exit之后才返回。
+// 子进程只能调用exec或者exit，不能从调用vfork的函数返回
+int vfork(void);
+int spawn(const char *path);
+int exec(const char *path);
 int wait(void);
 int waitpid(int pid, int *store);
 int sleep(unsigned int time);
 unsigned int gettime_msec(void);
+int clock_gettime(int clock_id, struct timespec *ts);
+uint64_t clock_ns(void);
+int clock_ns_per(uint64_t start, uint32_t n);
+int nanosleep(const struct timespec *req);
 void yield(void);
 int kill(int pid);
 int getpid(void);
+int nice(int nice);
 void print_page_dir(void);
 int mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 int munmap(uintptr_t addr, size_t len);
 int shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
+int fault_around(int npages);
+int pgfaults(void);
+int kmonitor(const char *cmd);
 int clone(uint32_t clone_flags, uintptr_t stack, int (*fn)(void *), void *arg);
 sem_t sem_init(int value);
 int sem_post(sem_t sem_id);
@@ -0,0 +1,67 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// 比较fork+exec、vfork+exec和spawn启动一个短任务的开销。
+// 父进程先占用并写过一块内存，fork时dup_mmap需要复制这些页表和页面，vfork和spawn则不需要。
+// 被启动的程序从文件系统中加载，需要事先把obj/user/hello拷贝到disk0/目录下，找不到时直接报错退出
+#define PROGRAM         "hello"
+#define ITERATIONS      20
+#define HEAP_SIZE       (1024 * 1024)
+
+static char heap[HEAP_SIZE];
+
+static void report(const char *name, uint64_t start) {
+    printf("%s: %d us per task.\n", name, clock_ns_per(start, ITERATIONS * 1000));
+}
+
+static void reap(int pid) {
+    int exit_code;
+    assert(pid > 0);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+}
+
+int main(void) {
+    int i, pid;
+    uint64_t start;
+
+    memset(heap, 1, sizeof(heap));
+
+    // 先试着启动一次，程序不在磁盘上时后面的fork+exec只会在子进程里失败，这里给出明确的提示
+    if ((pid = spawn(PROGRAM)) < 0) {
+        printf("spawn_bench: cannot start %s (%e), copy obj/user/%s into disk0/.\n",
+            PROGRAM, pid, PROGRAM);
+        return pid;
+    }
+    reap(pid);
+
+    start = clock_ns();
+    for (i = 0; i < ITERATIONS; i++) {
+        if ((pid = fork()) == 0) {
+            exec(PROGRAM);
+            exit(-1);
+        }
+        reap(pid);
+    }
+    report("fork+exec", start);
+
+    start = clock_ns();
+    for (i = 0; i < ITERATIONS; i++) {
+        if ((pid = vfork()) == 0) {
+            exec(PROGRAM);
+            exit(-1);
+        }
+        reap(pid);
+    }
+    report("vfork+exec", start);
+
+    start = clock_ns();
+    for (i = 0; i < ITERATIONS; i++) {
+        reap(spawn(PROGRAM));
+    }
+    report("spawn", start);
+
+    printf("spawn_bench pass.\n");
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <thread.h>
+#include <time.h>
+
+// 上下文切换的开销：两个执行流交替yield，统计平均每次yield的时间。
+// 同一个mm的两个线程之间切换不需要重新加载cr3，两个进程之间切换需要
+#define ITERATIONS      10000
+
+static int yield_loop(void *arg) {
+    int i;
+    for (i = 0; i < ITERATIONS; i++) {
+        yield();
+    }
+    return 0;
+}
+
+static void report(const char *name, uint64_t start) {
+    printf("%s: %d ns per yield.\n", name, clock_ns_per(start, ITERATIONS * 2));
+}
+
+int main(void) {
+    int exit_code;
+    uint64_t start;
+
+    Thread tid;
+    start = clock_ns();
+    assert(thread(yield_loop, NULL, &tid) == 0);
+    yield_loop(NULL);
+    assert(thread_wait(&tid, &exit_code) == 0 && exit_code == 0);
+    report("threads (shared mm)", start);
+
+    int pid;
+    start = clock_ns();
+    if ((pid = fork()) == 0) {
+        exit(yield_loop(NULL));
+    }
+    assert(pid > 0);
+    yield_loop(NULL);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    report("processes", start);
+
+    printf("switch_bench pass.\n");
+    return 0;
+}
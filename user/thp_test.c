@@ -0,0 +1,65 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+// 透明大页：mmap一块较大的匿名内存，其中完全覆盖的4M区域在第一次缺页时用4M大页映射。
+// 第一次写入时通过缺页次数确认用上了大页，再检查fork之后的写时复制、部分munmap拆分大页之后数据都保持正确，
+// 并统计逐页写入的时间
+#define MAP_SIZE        (12 * 1024 * 1024)
+#define HUGE_SIZE       (4 * 1024 * 1024)
+
+static char pattern(uintptr_t addr) {
+    return (char)((addr / PAGE_SIZE) * 7 + 1);
+}
+
+int main(void) {
+    uintptr_t addr = 0, va;
+    assert(mmap(&addr, MAP_SIZE, MMAP_WRITE) == 0 && addr != 0);
+
+    // 完全覆盖的4M区域各缺页一次，两端不足4M的部分最多每个page缺页一次
+    uintptr_t huge_start = ROUNDUP(addr, HUGE_SIZE), huge_end = ROUNDDOWN(addr + MAP_SIZE, HUGE_SIZE);
+    int nr_huge = (huge_end - huge_start) / HUGE_SIZE;
+    int max_faults = nr_huge + (MAP_SIZE - (huge_end - huge_start)) / PAGE_SIZE;
+    assert(nr_huge >= 2);
+
+    int faults = pgfaults();
+    uint64_t start = clock_ns();
+    for (va = addr; va < addr + MAP_SIZE; va += PAGE_SIZE) {
+        *(char *)va = pattern(va);
+    }
+    faults = pgfaults() - faults;
+    if (faults > max_faults) {
+        panic("thp_test: %d faults for %d huge regions, expected at most %d.\n",
+            faults, nr_huge, max_faults);
+    }
+    printf("thp_test: first touch %d faults, %d ns/page.\n", faults, clock_ns_per(start, MAP_SIZE / PAGE_SIZE));
+
+    int pid, exit_code;
+    if ((pid = fork()) == 0) {
+        for (va = addr; va < addr + MAP_SIZE; va += PAGE_SIZE * 3) {
+            assert(*(char *)va == pattern(va));
+            *(char *)va = 0;
+        }
+        exit(0);
+    }
+    assert(pid > 0 && waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    for (va = addr; va < addr + MAP_SIZE; va += PAGE_SIZE) {
+        assert(*(char *)va == pattern(va));
+    }
+    printf("thp_test: cow after fork ok.\n");
+
+    // 在第二个4M区域中间挖掉一个page
+    uintptr_t hole = huge_start + HUGE_SIZE + 5 * PAGE_SIZE;
+    assert(munmap(hole, PAGE_SIZE) == 0);
+    for (va = addr; va < addr + MAP_SIZE; va += PAGE_SIZE) {
+        if (va != hole) {
+            assert(*(char *)va == pattern(va));
+        }
+    }
+    printf("thp_test: partial munmap ok.\n");
+
+    assert(munmap(addr, MAP_SIZE) == 0);
+    printf("thp_test pass.\n");
+    return 0;
+}